@@ -0,0 +1,73 @@
+// Formatter benchmark.
+//
+// Formats the same values in all four bases, as the calculator does for every
+// result, once with format_uint and once with snprintf. Octal and binary have
+// no standard printf conversion with grouping, so snprintf is only timed on
+// decimal and hexadecimal.
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "format.h"
+
+#define ITERATIONS 200000
+
+static const uint64_t g_values[] = {
+    0, 7, 250, 9600, 16000000, 0xDEADBEEF, 1234567890123, UINT64_MAX,
+};
+
+#define VALUE_COUNT (sizeof(g_values) / sizeof(g_values[0]))
+
+static const FormatSpec g_specs[] = {
+    {FORMAT_BASE_DEC, 0, 0, false},
+    {FORMAT_BASE_HEX, 0, 0, true},
+    {FORMAT_BASE_OCT, 0, 0, true},
+    {FORMAT_BASE_BIN, 4, '_', true},
+};
+
+#define SPEC_COUNT (sizeof(g_specs) / sizeof(g_specs[0]))
+
+static double
+now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main() {
+    char buff[FORMAT_BUFF_SIZE];
+    size_t checksum = 0;
+
+    double start = now_ns();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        for (size_t j = 0; j < VALUE_COUNT; j++) {
+            checksum += format_uint(g_values[j], &g_specs[0], buff, sizeof(buff));
+            checksum += format_uint(g_values[j], &g_specs[1], buff, sizeof(buff));
+        }
+    }
+    double format_dec_hex = (now_ns() - start) / (ITERATIONS * VALUE_COUNT);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        for (size_t j = 0; j < VALUE_COUNT; j++) {
+            checksum += (size_t)snprintf(buff, sizeof(buff), "%" PRIu64, g_values[j]);
+            checksum += (size_t)snprintf(buff, sizeof(buff), "0x%" PRIX64, g_values[j]);
+        }
+    }
+    double printf_dec_hex = (now_ns() - start) / (ITERATIONS * VALUE_COUNT);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        for (size_t j = 0; j < VALUE_COUNT; j++) {
+            for (size_t k = 0; k < SPEC_COUNT; k++) {
+                checksum += format_uint(g_values[j], &g_specs[k], buff, sizeof(buff));
+            }
+        }
+    }
+    double format_all = (now_ns() - start) / (ITERATIONS * VALUE_COUNT);
+
+    fprintf(stdout, "format: decimal and hex %.1f ns (snprintf %.1f ns), all four bases %.1f ns (checksum %zu)\n",
+            format_dec_hex, printf_dec_hex, format_all, checksum);
+    return 0;
+}
@@ -0,0 +1,41 @@
+// Expression reset benchmark.
+//
+// Parses and evaluates a short expression over and over. Every parse starts by
+// resetting the expression, so the time per expression should stay flat as the
+// pool grows, IE compare:
+//   make bench
+//   make bench CFLAGS=-DMAX_TOKENS_PER_EXPR=4096
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "config.h"
+#include "expression.h"
+
+#define ITERATIONS 1000000
+
+static double
+now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main() {
+    Expression *expr = expression_take_reference();
+    uint64_t checksum = 0;
+
+    double start = now_ns();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        uint64_t value = 0;
+        expression_set_from_str(expr, "(3 + 4) * 5");
+        expression_evaluate(expr, &value);
+        checksum += value;
+    }
+    double elapsed = now_ns() - start;
+
+    fprintf(stdout, "reset: %d tokens per pool, %.1f ns per expression (checksum %" PRIu64 ")\n",
+            MAX_TOKENS_PER_EXPR, elapsed / ITERATIONS, checksum);
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Evaluator benchmark.
+//
+// Runs the same expressions through the tree evaluator, the stack machine and
+// the register machine. The expressions are built once and compiled once, so
+// only evaluation is timed. Most operands are literals, as in real inputs, which
+// lets the register machine fuse them into its instructions.
+//
+// expression_evaluate hands back the value cached at the root of the tree once
+// nothing has been edited, so the tree is timed through the 64 bit walk of the
+// number layer, which caches nothing. The cached lookup is shown separately.
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "bytecode.h"
+#include "config.h"
+#include "expression.h"
+#include "regcode.h"
+
+#define ITERATIONS 1000000
+
+static const char *const g_inputs[] = {
+    "200 & 0xF0",
+    "(5 << 4) | 3",
+    "1234567 % 16",
+    "((0x1234 >> 4) & 0xFF) * 3 + (77 ^ 0b1010) - ~(12 | 1) / 5",
+    "16000000 / (16 * 9600) - 1",
+    "(16000000 / 1024) / 61 % 250",
+};
+
+#define INPUT_COUNT (sizeof(g_inputs) / sizeof(g_inputs[0]))
+
+static double
+now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main() {
+    static uint8_t code_buff[INPUT_COUNT][BYTECODE_SIZE(MAX_TOKENS_PER_EXPR)];
+    static RegInstr reg_buff[INPUT_COUNT][REGCODE_SIZE(MAX_TOKENS_PER_EXPR)];
+
+    Expression *exprs[INPUT_COUNT];
+    Bytecode code[INPUT_COUNT];
+    RegCode reg_code[INPUT_COUNT];
+    for (size_t i = 0; i < INPUT_COUNT; i++) {
+        exprs[i] = expression_take_reference();
+        bytecode_init(&code[i], code_buff[i], sizeof(code_buff[i]));
+        regcode_init(&reg_code[i], reg_buff[i], REGCODE_SIZE(MAX_TOKENS_PER_EXPR));
+        if (exprs[i] == NULL
+            || expression_set_from_str(exprs[i], g_inputs[i]) != MATH_ERR_OK
+            || expression_compile(exprs[i], &code[i]) != MATH_ERR_OK
+            || expression_compile_regcode(exprs[i], &reg_code[i]) != MATH_ERR_OK) {
+            fprintf(stdout, "vm: could not compile \"%s\"\n", g_inputs[i]);
+            return 1;
+        }
+    }
+
+    for (size_t i = 0; i < INPUT_COUNT; i++) {
+        uint64_t tree_sum = 0;
+        uint64_t cached_sum = 0;
+        uint64_t stack_sum = 0;
+        uint64_t reg_sum = 0;
+        uint64_t value = 0;
+
+        double start = now_ns();
+        for (uint32_t j = 0; j < ITERATIONS; j++) {
+            expression_evaluate_sized(exprs[i], SIZE_MODE_QWORD, &value);
+            tree_sum += value;
+        }
+        double tree_ns = (now_ns() - start) / ITERATIONS;
+
+        start = now_ns();
+        for (uint32_t j = 0; j < ITERATIONS; j++) {
+            expression_evaluate(exprs[i], &value);
+            cached_sum += value;
+        }
+        double cached_ns = (now_ns() - start) / ITERATIONS;
+
+        start = now_ns();
+        for (uint32_t j = 0; j < ITERATIONS; j++) {
+            bytecode_run(&code[i], &value);
+            stack_sum += value;
+        }
+        double stack_ns = (now_ns() - start) / ITERATIONS;
+
+        start = now_ns();
+        for (uint32_t j = 0; j < ITERATIONS; j++) {
+            regcode_run(&reg_code[i], &value);
+            reg_sum += value;
+        }
+        double reg_ns = (now_ns() - start) / ITERATIONS;
+
+        if (tree_sum != cached_sum || tree_sum != stack_sum || tree_sum != reg_sum) {
+            fprintf(stdout, "vm: results differ for \"%s\"\n", g_inputs[i]);
+            return 1;
+        }
+
+        fprintf(stdout,
+                "vm: \"%s\": tree %.1f ns (cached %.1f ns), stack %.1f ns (%zu bytes), register %.1f ns (%zu instructions)\n",
+                g_inputs[i], tree_ns, cached_ns, stack_ns, code[i].size, reg_ns, reg_code[i].size);
+    }
+
+    return 0;
+}
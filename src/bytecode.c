@@ -0,0 +1,186 @@
+#include "bytecode.h"
+#include "operator.h"
+#include "tok_pool.h"
+
+void
+bytecode_init(Bytecode *code, uint8_t *buff, size_t capacity) {
+    code->code = buff;
+    code->size = 0;
+    code->capacity = capacity;
+    code->depth = 0;
+}
+
+static MathErr
+emit_literal(Bytecode *code, uint64_t value) {
+    uint8_t opcode = OPC_PUSH64;
+    size_t bytes = 8;
+    if (value <= UINT8_MAX) {
+        opcode = OPC_PUSH8;
+        bytes = 1;
+    } else if (value <= UINT16_MAX) {
+        opcode = OPC_PUSH16;
+        bytes = 2;
+    } else if (value <= UINT32_MAX) {
+        opcode = OPC_PUSH32;
+        bytes = 4;
+    }
+
+    if (code->capacity - code->size < bytes + 1) {
+        return MATH_ERR_OUT_OF_CODE;
+    }
+
+    code->code[code->size++] = opcode;
+    for (size_t i = 0; i < bytes; i++) {
+        code->code[code->size++] = (uint8_t)(value >> (8 * i));
+    }
+    return MATH_ERR_OK;
+}
+
+static MathErr
+emit_opcode(Bytecode *code, uint8_t opcode) {
+    if (code->size == code->capacity) {
+        return MATH_ERR_OUT_OF_CODE;
+    }
+
+    code->code[code->size++] = opcode;
+    return MATH_ERR_OK;
+}
+
+// Emits a built tree in post-order, and sets *depth to the most values the
+// stack holds while its code runs.
+static MathErr
+subtree_compile(const TokPool *pool, TokRef node, Bytecode *code, size_t *depth) {
+    TokenType type = tok_type(pool, node);
+    if (type == TOK_INTEGER) {
+        *depth = 1;
+        return emit_literal(code, tok_value(pool, node));
+    }
+
+    MathErr err;
+    size_t lhs_depth = 0;
+    TokRef left = tok_left(pool, node);
+    if (left != TOK_NIL) {
+        err = subtree_compile(pool, left, code, &lhs_depth);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+    }
+
+    size_t rhs_depth;
+    err = subtree_compile(pool, tok_right(pool, node), code, &rhs_depth);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    if (left == TOK_NIL) {
+        *depth = rhs_depth;
+        switch (type) {
+            case TOK_BITWISE_NOT: return emit_opcode(code, OPC_NOT);
+            case TOK_MINUS: return emit_opcode(code, OPC_NEG);
+            case TOK_PLUS: return MATH_ERR_OK;
+            default: return MATH_ERR_MALFORMED_EXPR;
+        }
+    }
+
+    // The left operand stays on the stack while the right one is computed.
+    *depth = lhs_depth > rhs_depth + 1 ? lhs_depth : rhs_depth + 1;
+    return emit_opcode(code, (uint8_t)type);
+}
+
+MathErr
+expression_compile(Expression *expr, Bytecode *code) {
+    code->size = 0;
+    code->depth = 0;
+
+    MathErr err = expression_build(expr);
+    if (err == MATH_ERR_OK) {
+        err = subtree_compile(&expr->tok_pool, expr->root, code, &code->depth);
+    }
+    if (err == MATH_ERR_OK && code->depth > EXPR_VM_STACK_DEPTH) {
+        err = MATH_ERR_STACK_OVERFLOW;
+    }
+
+    if (err != MATH_ERR_OK) {
+        code->size = 0;
+        code->depth = 0;
+    }
+    return err;
+}
+
+static uint64_t
+read_literal(const uint8_t *pc, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)pc[i] << (8 * i);
+    }
+    return value;
+}
+
+// The top of the stack is kept in tos rather than in memory, so unary operators
+// never touch the stack and binary ones pop a single value. The first push
+// spills the meaningless initial tos, which the depth computed at compile time
+// already leaves room for.
+MathErr
+bytecode_run(const Bytecode *code, uint64_t *result) {
+    if (code->size == 0) {
+        return MATH_ERR_MALFORMED_EXPR;
+    } else if (code->depth > EXPR_VM_STACK_DEPTH) {
+        return MATH_ERR_STACK_OVERFLOW;
+    }
+
+    uint64_t stack[EXPR_VM_STACK_DEPTH];
+    size_t sp = 0;
+    uint64_t tos = 0;
+
+    const uint8_t *pc = code->code;
+    const uint8_t *end = pc + code->size;
+    while (pc != end) {
+        MathErr err;
+        uint8_t opcode = *pc++;
+        switch (opcode) {
+            case OPC_PUSH8:
+                stack[sp++] = tos;
+                tos = pc[0];
+                pc += 1;
+                continue;
+            case OPC_PUSH16:
+                stack[sp++] = tos;
+                tos = read_literal(pc, 2);
+                pc += 2;
+                continue;
+            case OPC_PUSH32:
+                stack[sp++] = tos;
+                tos = read_literal(pc, 4);
+                pc += 4;
+                continue;
+            case OPC_PUSH64:
+                stack[sp++] = tos;
+                tos = read_literal(pc, 8);
+                pc += 8;
+                continue;
+
+            case OPC_NOT: err = operation_bitwise_not(0, tos, &tos); break;
+            case OPC_NEG: err = operation_negate(0, tos, &tos); break;
+
+            case OPC_MUL: err = operation_multiply(stack[--sp], tos, &tos); break;
+            case OPC_DIV: err = operation_divide(stack[--sp], tos, &tos); break;
+            case OPC_MOD: err = operation_modulo(stack[--sp], tos, &tos); break;
+            case OPC_ADD: err = operation_add(stack[--sp], tos, &tos); break;
+            case OPC_SUB: err = operation_subtract(stack[--sp], tos, &tos); break;
+            case OPC_SHL: err = operation_shift_left(stack[--sp], tos, &tos); break;
+            case OPC_SHR: err = operation_shift_right(stack[--sp], tos, &tos); break;
+            case OPC_AND: err = operation_bitwise_and(stack[--sp], tos, &tos); break;
+            case OPC_XOR: err = operation_bitwise_xor(stack[--sp], tos, &tos); break;
+            case OPC_OR: err = operation_bitwise_or(stack[--sp], tos, &tos); break;
+
+            default: return MATH_ERR_MALFORMED_EXPR;
+        }
+
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+    }
+
+    *result = tos;
+    return MATH_ERR_OK;
+}
@@ -0,0 +1,65 @@
+#ifndef _BYTECODE_H
+#define _BYTECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "error.h"
+#include "expression.h"
+#include "token.h"
+
+// A compiled expression is its tree flattened into postfix order, run by a
+// small stack machine. Each instruction is a one byte opcode. Operators keep
+// the value of their TokenType, so most of them compile with a cast, and
+// literals follow their opcode inline as 1, 2, 4 or 8 little endian bytes,
+// whichever is the shortest that holds them.
+typedef enum Opcode {
+    OPC_NOT = TOK_BITWISE_NOT,
+    OPC_MUL = TOK_TIMES,
+    OPC_DIV = TOK_DIVIDED_BY,
+    OPC_MOD = TOK_MODULO,
+    OPC_ADD = TOK_PLUS,
+    OPC_SUB = TOK_MINUS,
+    OPC_SHL = TOK_BITWISE_LEFT_SHIFT,
+    OPC_SHR = TOK_BITWISE_RIGHT_SHIFT,
+    OPC_AND = TOK_BITWISE_AND,
+    OPC_XOR = TOK_BITWISE_XOR,
+    OPC_OR = TOK_BITWISE_OR,
+    OPC_PUSH8 = TOK_INTEGER,
+    OPC_PUSH16,
+    OPC_PUSH32,
+    OPC_PUSH64,
+    OPC_NEG
+} Opcode;
+
+// Longest an instruction can be.
+#define BYTECODE_MAX_INSTRUCTION 9
+
+// Bytes needed to be sure an expression of the given number of tokens will
+// compile.
+#define BYTECODE_SIZE(tokens) ((tokens) * BYTECODE_MAX_INSTRUCTION)
+
+typedef struct Bytecode {
+    uint8_t *code;
+    size_t size;
+    size_t capacity;
+
+    // Most values the stack holds at once while running the code.
+    size_t depth;
+} Bytecode;
+
+// Binds a program to capacity bytes of caller memory.
+void bytecode_init(Bytecode *code, uint8_t *buff, size_t capacity);
+
+// Compiles an expression, replacing whatever code held before. Fails with
+// MATH_ERR_OUT_OF_CODE if the program does not fit, or MATH_ERR_STACK_OVERFLOW
+// if running it would need more than EXPR_VM_STACK_DEPTH values. The program
+// does not refer back to the expression, which can be changed or reused.
+MathErr expression_compile(Expression *expr, Bytecode *code);
+
+// Runs a compiled program. Gives the same result as evaluating the expression
+// it was compiled from.
+MathErr bytecode_run(const Bytecode *code, uint64_t *result);
+
+#endif // _BYTECODE_H
@@ -0,0 +1,73 @@
+#ifndef _CONFIG_H
+#define _CONFIG_H
+
+// Build time configuration. Every option can be overridden from the compiler
+// command line, IE make CFLAGS="-DEXPR_COMPACT_TOKENS -DMAX_TOKENS_PER_EXPR=48"
+
+// Define EXPR_COMPACT_TOKENS to store tokens as a structure of arrays linked by
+// pool indices rather than pointers. It is needed on targets where the default
+// layout does not fit in RAM, and speeds up scans over long expressions on the
+// host. See tok_pool.h.
+
+// Width in bits of the integer literals held by compact tokens. Literals which
+// do not fit are rejected with MATH_ERR_LITERAL_OVERFLOW.
+#ifndef EXPR_VALUE_BITS
+#define EXPR_VALUE_BITS 64
+#endif
+
+// Tokens held by each expression handed out by expression_take_reference.
+// Expressions over caller provided arenas, or growable ones on the host, are
+// not limited by this.
+#ifndef MAX_TOKENS_PER_EXPR
+#ifdef EXPR_COMPACT_TOKENS
+#define MAX_TOKENS_PER_EXPR 64
+#else
+#define MAX_TOKENS_PER_EXPR 256
+#endif
+#endif
+
+// Width of the indices linking compact tokens, which caps the number of tokens
+// in any one expression. Defaults to the narrowest width that can address
+// MAX_TOKENS_PER_EXPR tokens; widen it to use larger arenas.
+#ifndef EXPR_TOKEN_REF_BITS
+#if MAX_TOKENS_PER_EXPR < 255
+#define EXPR_TOKEN_REF_BITS 8
+#else
+#define EXPR_TOKEN_REF_BITS 16
+#endif
+#endif
+
+// Number of expressions expression_take_reference can hand out at once.
+#ifndef EXPR_CONTEXT_COUNT
+#ifdef __AVR__
+#define EXPR_CONTEXT_COUNT 1
+#else
+#define EXPR_CONTEXT_COUNT 8
+#endif
+#endif
+
+// Values the bytecode VM can hold on its stack. Compiling an expression which
+// would need more fails with MATH_ERR_STACK_OVERFLOW.
+#ifndef EXPR_VM_STACK_DEPTH
+#ifdef __AVR__
+#define EXPR_VM_STACK_DEPTH 16
+#else
+#define EXPR_VM_STACK_DEPTH 64
+#endif
+#endif
+
+// Define EXPR_SHUNTING_YARD to have expression_evaluate reduce the tokens in a
+// single pass, without building a tree. See shunt.h.
+
+// Open parenthesis, pending operators and pending values the single pass
+// evaluator can each hold. Expressions nested deeper than this fail with
+// MATH_ERR_STACK_OVERFLOW.
+#ifndef EXPR_SHUNT_DEPTH
+#ifdef __AVR__
+#define EXPR_SHUNT_DEPTH 8
+#else
+#define EXPR_SHUNT_DEPTH 64
+#endif
+#endif
+
+#endif // _CONFIG_H
@@ -1,3 +1,5 @@
+#ifndef _ERROR_H
+#define _ERROR_H
 
 typedef enum MathErr {
     MATH_ERR_OK = 0,
@@ -5,4 +7,10 @@ typedef enum MathErr {
     MATH_ERR_OPERAND_NAN,
     MATH_ERR_PARENTHESIS_MISMATCH,
     MATH_ERR_MALFORMED_EXPR,
+    MATH_ERR_LITERAL_OVERFLOW,
+    MATH_ERR_OUT_OF_TOKENS,
+    MATH_ERR_OUT_OF_CODE,
+    MATH_ERR_STACK_OVERFLOW,
 } MathErr;
+
+#endif // _ERROR_H
@@ -1,4 +1,6 @@
 #include "expression.h"
+#include "operator.h"
+#include "shunt.h"
 
 #include <memory.h>
 #include <stdio.h>
@@ -7,182 +9,975 @@
 #include <string.h>
 #include <stdlib.h>
 
-#define MAX_TOKENS_PER_EXPR 256
+// Expressions handed out by expression_take_reference, and their tokens.
+static Expression g_expr_pool[EXPR_CONTEXT_COUNT];
+static uint8_t g_tok_arena[EXPR_CONTEXT_COUNT][TOK_ARENA_SIZE(MAX_TOKENS_PER_EXPR)];
 
-struct Expression {
-    size_t size;
-    Token tok_pool[MAX_TOKENS_PER_EXPR];
-    Token *start;
-    Token *end;
-};
+#ifdef __AVR__
 
-// Global expression reference.
-Expression g_expr_ref;
-bool g_ref_taken = false;
+#include <util/atomic.h>
+
+static bool g_expr_taken[EXPR_CONTEXT_COUNT];
+
+// Interrupts are held off while the flags are searched, so a reference can be
+// taken from an ISR while the main loop is doing the same.
+static bool
+context_claim(size_t index) {
+    bool claimed = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (! g_expr_taken[index]) {
+            g_expr_taken[index] = true;
+            claimed = true;
+        }
+    }
+    return claimed;
+}
+
+static void
+context_release(size_t index) {
+    // A single byte store can not be torn on AVR.
+    g_expr_taken[index] = false;
+}
+
+#else
+
+#include <stdatomic.h>
+
+static atomic_bool g_expr_taken[EXPR_CONTEXT_COUNT];
+
+// Lock-free: whichever thread swaps the flag from false to true owns the
+// context until it stores false again.
+static bool
+context_claim(size_t index) {
+    return ! atomic_exchange_explicit(&g_expr_taken[index], true, memory_order_acquire);
+}
+
+static void
+context_release(size_t index) {
+    atomic_store_explicit(&g_expr_taken[index], false, memory_order_release);
+}
+
+#endif
 
 Expression *
 expression_take_reference() {
-    // Only one reference may be taken.
-    if (g_ref_taken) {
-        return NULL;
+    for (size_t i = 0; i < EXPR_CONTEXT_COUNT; i++) {
+        if (context_claim(i)) {
+            expression_init(&g_expr_pool[i], g_tok_arena[i], sizeof(g_tok_arena[i]));
+            return &g_expr_pool[i];
+        }
     }
 
-    expression_reset(&g_expr_ref);
-    g_ref_taken = true;
-    return &g_expr_ref;
+    return NULL;
 }
 
-bool
-expression_append_token(Expression *expr, Token *tok) {
-    if (expr->start == NULL) {
+void
+expression_return_reference(Expression *expr) {
+    // Caller provided storage was never taken from the pool.
+    if (expr < g_expr_pool || expr >= g_expr_pool + EXPR_CONTEXT_COUNT) {
+        return;
+    }
+
+    context_release((size_t)(expr - g_expr_pool));
+}
+
+void
+expression_init(Expression *expr, void *arena, size_t arena_size) {
+    tok_pool_init_arena(&expr->tok_pool, arena, arena_size);
+    expr->preview = NULL;
+    expression_reset(expr);
+}
+
+#ifndef __AVR__
+void
+expression_init_growable(Expression *expr, size_t chunk_tokens) {
+    tok_pool_init_growable(&expr->tok_pool, chunk_tokens);
+    expr->preview = NULL;
+    expression_reset(expr);
+}
+
+void
+expression_free(Expression *expr) {
+    tok_pool_free(&expr->tok_pool);
+    expression_reset(expr);
+}
+#endif
+
+// Starts the live preview over, once a token it may already have consumed
+// changes. Only edits at the very end of the expression leave it be.
+static void
+expression_preview_reset(Expression *expr) {
+    if (expr->preview != NULL) {
+        shunt_init(&expr->preview->shunt);
+        expr->preview->fed = TOK_NIL;
+    }
+}
+
+// Whether tok is the last token fed to the attached preview.
+static bool
+preview_fed(const Expression *expr, TokRef tok) {
+    return expr->preview != NULL && expr->preview->fed == tok;
+}
+
+static bool
+is_dirty(const TokPool *pool, TokRef tok) {
+    return (tok_flags(pool, tok) & TOK_FLAG_DIRTY) != 0;
+}
+
+static void
+set_dirty(TokPool *pool, TokRef tok, bool dirty) {
+    uint8_t flags = tok_flags(pool, tok);
+    tok_set_flags(pool, tok, (uint8_t)(dirty ? flags | TOK_FLAG_DIRTY : flags & ~TOK_FLAG_DIRTY));
+}
+
+// Changes the value of a literal in place. The shape of the tree does not
+// depend on values, so it stays built, and only the operators on the path from
+// the literal up to the root go dirty. Every operator above a dirty one is
+// dirty already, so the walk stops at the first. Without a tree, the literal
+// itself is marked for the next build to pick up.
+static void
+expression_set_literal(Expression *expr, TokRef tok, uint64_t value) {
+    TokPool *pool = &expr->tok_pool;
+    tok_set_value(pool, tok, value);
+
+    if (tok != expr->end || preview_fed(expr, tok)) {
+        expression_preview_reset(expr);
+    }
+
+    if (expr->root == TOK_NIL) {
+        set_dirty(pool, tok, true);
+        return;
+    }
+
+    TokRef node = tok_parent(pool, tok);
+    while (node != TOK_NIL && ! is_dirty(pool, node)) {
+        set_dirty(pool, node, true);
+        node = tok_parent(pool, node);
+    }
+}
+
+// Links a new token from the pool in just after the token after, or at the
+// start of the expression if after is TOK_NIL. New tokens start out dirty,
+// since an operator may still link to a slot which has been reused.
+static MathErr
+expression_link_token(Expression *expr, TokRef after, TokenType type, uint64_t value, uint8_t flags,
+                      TokRef *linked) {
+    if (! tok_value_fits(value)) {
+        return MATH_ERR_LITERAL_OVERFLOW;
+    }
+
+    TokPool *pool = &expr->tok_pool;
+    TokRef tok = tok_pool_alloc(pool);
+    if (tok == TOK_NIL) {
+        return MATH_ERR_OUT_OF_TOKENS;
+    }
+    tok_init(pool, tok, type, value);
+    tok_set_flags(pool, tok, (uint8_t)(flags | TOK_FLAG_DIRTY));
+
+    TokRef next = after == TOK_NIL ? expr->start : tok_next(pool, after);
+    tok_set_pre(pool, tok, after);
+    tok_set_next(pool, tok, next);
+    if (after == TOK_NIL) {
         expr->start = tok;
-        expr->end = expr->start;
     } else {
-        tok->pre = expr->end;
-        expr->end->next = tok;
+        tok_set_next(pool, after, tok);
+    }
+    if (next == TOK_NIL) {
         expr->end = tok;
+    } else {
+        tok_set_pre(pool, next, tok);
+        tok_pool_unorder(pool);
+        expression_preview_reset(expr);
     }
 
     expr->size += 1;
-    return true;
+    expr->root = TOK_NIL;
+    *linked = tok;
+    return MATH_ERR_OK;
+}
+
+// Appends a new token from the pool to the end of the expression.
+static MathErr
+expression_append_token(Expression *expr, TokenType type, uint64_t value, uint8_t flags) {
+    TokRef linked;
+    return expression_link_token(expr, expr->end, type, value, flags, &linked);
 }
 
 bool
 expression_append_operator(Expression *expr, TokenType type) {
-    Token *new_tok = &expr->tok_pool[expr->size]; // TODO: Check size is within max.
-    token_set_operator(new_tok, type);
-    return expression_append_token(expr, new_tok);
+    return expression_append_token(expr, type, 0, 0) == MATH_ERR_OK;
 }
 
 bool
 expression_append_int(Expression *expr, uint64_t value) {
-    Token *new_tok = &expr->tok_pool[expr->size]; // TODO: Check size is within max.
-    token_set_integer(new_tok, value);
-    return expression_append_token(expr, new_tok);
+    return expression_append_token(expr, TOK_INTEGER, value, TOK_FLAG_BASE_DEC) == MATH_ERR_OK;
+}
+
+// Unlinks tok from the expression and returns it to the pool. A cursor on it
+// moves back to the token before, taking over the whitespace which came
+// before it.
+static void
+expression_unlink(Expression *expr, TokRef tok) {
+    TokPool *pool = &expr->tok_pool;
+    TokRef pre = tok_pre(pool, tok);
+    TokRef next = tok_next(pool, tok);
+    if (pre == TOK_NIL) {
+        expr->start = next;
+    } else {
+        tok_set_next(pool, pre, next);
+    }
+    if (next == TOK_NIL) {
+        expr->end = pre;
+    } else {
+        tok_set_pre(pool, next, pre);
+    }
+
+    if (next != TOK_NIL || preview_fed(expr, tok)) {
+        expression_preview_reset(expr);
+    }
+
+    if (expr->cursor == tok) {
+        expr->cursor = pre;
+        expr->spaced = (tok_flags(pool, tok) & TOK_FLAG_SPACE) != 0;
+    }
+
+    tok_pool_release(pool, tok);
+    expr->size -= 1;
+    expr->root = TOK_NIL;
+}
+
+// Returns the token at pos, which must be in range.
+static TokRef
+expression_token_at(const Expression *expr, int pos) {
+    TokRef tok = expr->start;
+    for (int i = 0; i < pos; i++) {
+        tok = tok_next(&expr->tok_pool, tok);
+    }
+    return tok;
+}
+
+// Inserts a token before the token at pos, or at the end if pos is the
+// number of tokens.
+static MathErr
+expression_insert_token(Expression *expr, TokenType type, uint64_t value, int pos) {
+    if (pos < 0 || (size_t)pos > expr->size) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+
+    TokRef after = pos == 0 ? TOK_NIL : expression_token_at(expr, pos - 1);
+    TokRef linked;
+    return expression_link_token(expr, after, type, value, 0, &linked);
+}
+
+bool
+expression_insert_operator(Expression *expr, TokenType type, int pos) {
+    return expression_insert_token(expr, type, 0, pos) == MATH_ERR_OK;
+}
+
+bool
+expression_insert_int(Expression *expr, uint64_t value, int pos) {
+    return expression_insert_token(expr, TOK_INTEGER, value, pos) == MATH_ERR_OK;
+}
+
+bool
+expression_remove(Expression *expr, int pos) {
+    if (pos < 0 || (size_t)pos >= expr->size) {
+        return false;
+    }
+
+    expression_unlink(expr, expression_token_at(expr, pos));
+    return true;
 }
 
+void
+expression_compact(Expression *expr) {
+    // Tokens move, so the cursor is carried across by position.
+    int cursor_pos = 0;
+    for (TokRef tok = expr->cursor; tok != TOK_NIL; tok = tok_pre(&expr->tok_pool, tok)) {
+        cursor_pos += 1;
+    }
+
+    tok_pool_compact(&expr->tok_pool, &expr->start, &expr->end);
+    expr->root = TOK_NIL;
+    expression_preview_reset(expr);
+    expr->cursor = cursor_pos == 0 ? TOK_NIL : expression_token_at(expr, cursor_pos - 1);
+}
+
+// Costs the same regardless of the size of the pool. Slots are never cleared
+// here, since each one is fully initialized as it is allocated, and nothing
+// reads a slot which has not been.
 void
 expression_reset(Expression *expr) {
-    memset(expr, 0, sizeof(Expression));
+    tok_pool_clear(&expr->tok_pool);
+    expr->size = 0;
+    expr->start = TOK_NIL;
+    expr->end = TOK_NIL;
+    expr->root = TOK_NIL;
+    expr->cursor = TOK_NIL;
+    expr->pending = 0;
+    expr->spaced = false;
+    expression_preview_reset(expr);
 }
 
-bool
-expression_set_from_str(Expression *expr, const char *str) {
+MathErr
+expression_set_from_buf(Expression *expr, const char *ptr, size_t len) {
     // Reset the expression.
     expression_reset(expr);
 
-    const char *cur_pos = str;
-    while (*cur_pos != '\0') {
-        Token *new_tok = &expr->tok_pool[expr->size]; // TODO: Check size is within max.
-        const char *new_pos = token_set_from_str(new_tok, cur_pos);
-        if (new_pos == cur_pos) {
-            // No characters were consumed, parse error!
+    const char *limit = ptr + len;
+    const char *cur_pos = token_skip_space(ptr, len);
+    bool spaced = cur_pos != ptr;
+    while (cur_pos != limit) {
+        Token new_tok;
+        const char *new_pos;
+        MathErr err = token_set_from_buf(&new_tok, cur_pos, (size_t)(limit - cur_pos), &new_pos);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+
+        uint8_t flags = new_tok.flags | (spaced ? TOK_FLAG_SPACE : 0);
+        err = expression_append_token(expr, new_tok.type, new_tok.value, flags);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+        cur_pos = token_skip_space(new_pos, (size_t)(limit - new_pos));
+        spaced = cur_pos != new_pos;
+    }
+
+    // Further typing carries on from the end of the text.
+    expr->cursor = expr->end;
+    expr->spaced = spaced;
+    return MATH_ERR_OK;
+}
+
+MathErr
+expression_set_from_str(Expression *expr, const char *str) {
+    return expression_set_from_buf(expr, str, strlen(str));
+}
+
+// Links a token typed at the cursor in after it, and moves the cursor past it.
+static MathErr
+edit_insert(Expression *expr, TokenType type, uint64_t value, uint8_t flags) {
+    if (expr->spaced) {
+        flags |= TOK_FLAG_SPACE;
+    }
+
+    TokRef linked;
+    MathErr err = expression_link_token(expr, expr->cursor, type, value, flags, &linked);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    expr->cursor = linked;
+    expr->spaced = false;
+    return MATH_ERR_OK;
+}
+
+// Bits per digit of a power of two base, or 0 for decimal.
+static uint8_t
+base_shift(uint8_t flags) {
+    switch (flags & TOK_FLAG_BASE_MASK) {
+        case TOK_FLAG_BASE_HEX: return 4;
+        case TOK_FLAG_BASE_OCT: return 3;
+        case TOK_FLAG_BASE_BIN: return 1;
+        default: return 0;
+    }
+}
+
+// Completes a held prefix with the character just typed. Only the second half
+// of a doubled operator, or a digit after a base prefix, can follow one.
+static MathErr
+edit_pending(Expression *expr, char c, TokenType type, uint8_t digit) {
+    if (expr->pending == '<' || expr->pending == '>') {
+        if (c != expr->pending) {
+            return MATH_ERR_MALFORMED_EXPR;
+        }
+        MathErr err = edit_insert(expr, type, 0, 0);
+        if (err == MATH_ERR_OK) {
+            expr->pending = 0;
+        }
+        return err;
+    }
+
+    uint8_t flags = expr->pending == 'x' ? TOK_FLAG_BASE_HEX : TOK_FLAG_BASE_BIN;
+    if (digit >= (1 << base_shift(flags))) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+    MathErr err = edit_insert(expr, TOK_INTEGER, digit, flags);
+    if (err == MATH_ERR_OK) {
+        expr->pending = 0;
+    }
+    return err;
+}
+
+// Appends a digit to the literal at the cursor, in its own base.
+static MathErr
+edit_extend(Expression *expr, TokChar kind, uint8_t digit) {
+    TokPool *pool = &expr->tok_pool;
+    TokRef tok = expr->cursor;
+    uint8_t flags = tok_flags(pool, tok);
+    uint64_t value = tok_value(pool, tok);
+
+    // A lone 0 is still deciding its base: a prefix letter drops it to be held
+    // along with the letter, and a further digit makes it octal.
+    if ((flags & TOK_FLAG_BASE_MASK) == TOK_FLAG_BASE_DEC && value == 0) {
+        if (kind == TOK_CHAR_PREFIX_X || kind == TOK_CHAR_PREFIX_B) {
+            expression_unlink(expr, tok);
+            expr->pending = kind == TOK_CHAR_PREFIX_X ? 'x' : 'b';
+            return MATH_ERR_OK;
+        } else if (digit >= 8) {
+            return MATH_ERR_MALFORMED_EXPR;
+        }
+        tok_set_flags(pool, tok, (uint8_t)((flags & ~TOK_FLAG_BASE_MASK) | TOK_FLAG_BASE_OCT));
+        expression_set_literal(expr, tok, digit);
+        return MATH_ERR_OK;
+    }
+
+    // Shifts and compares against constants, so no keystroke needs a 64 bit
+    // multiply or divide.
+    uint8_t shift = base_shift(flags);
+    if (shift == 0) {
+        if (digit >= 10) {
+            return MATH_ERR_MALFORMED_EXPR;
+        } else if (value > UINT64_MAX / 10 || (value == UINT64_MAX / 10 && digit > UINT64_MAX % 10)) {
+            return MATH_ERR_LITERAL_OVERFLOW;
+        }
+        value = (value << 3) + (value << 1) + digit;
+    } else {
+        if (digit >= (1 << shift)) {
+            return MATH_ERR_MALFORMED_EXPR;
+        } else if (value > (UINT64_MAX >> shift)) {
+            return MATH_ERR_LITERAL_OVERFLOW;
+        }
+        value = (value << shift) | digit;
+    }
+
+    if (! tok_value_fits(value)) {
+        return MATH_ERR_LITERAL_OVERFLOW;
+    }
+    expression_set_literal(expr, tok, value);
+    return MATH_ERR_OK;
+}
+
+MathErr
+expression_feed_char(Expression *expr, char c) {
+    TokenType type = TOK_INTEGER;
+    uint8_t digit;
+    TokChar kind = token_classify_char(c, &type, &digit);
+
+    if (expr->pending != 0) {
+        return edit_pending(expr, c, type, digit);
+    }
+
+    switch (kind) {
+        case TOK_CHAR_SPACE:
+            expr->spaced = true;
+            return MATH_ERR_OK;
+
+        case TOK_CHAR_OPERATOR: return edit_insert(expr, type, 0, 0);
+
+        case TOK_CHAR_DOUBLED:
+            expr->pending = c;
+            return MATH_ERR_OK;
+
+        case TOK_CHAR_DIGIT:
+        case TOK_CHAR_PREFIX_B:
+        case TOK_CHAR_PREFIX_X: {
+            TokRef tok = expr->cursor;
+            if (tok != TOK_NIL && ! expr->spaced && tok_type(&expr->tok_pool, tok) == TOK_INTEGER) {
+                return edit_extend(expr, kind, digit);
+            } else if (digit >= 10) {
+                return MATH_ERR_MALFORMED_EXPR;
+            }
+            return edit_insert(expr, TOK_INTEGER, digit, TOK_FLAG_BASE_DEC);
+        }
+
+        default: return MATH_ERR_MALFORMED_EXPR;
+    }
+}
+
+// Undoes the last digit of the literal at the cursor. Once only its prefix is
+// left, the prefix is held at the cursor again.
+static void
+edit_shorten(Expression *expr, TokRef tok) {
+    TokPool *pool = &expr->tok_pool;
+    uint8_t flags = tok_flags(pool, tok);
+    uint64_t value = tok_value(pool, tok);
+
+    switch (flags & TOK_FLAG_BASE_MASK) {
+        case TOK_FLAG_BASE_DEC:
+            if (value < 10) {
+                expression_unlink(expr, tok);
+                return;
+            }
+            value /= 10;
+            break;
+
+        case TOK_FLAG_BASE_OCT:
+            if (value < 8) {
+                // Back to the lone 0 which started it.
+                tok_set_flags(pool, tok, (uint8_t)(flags & ~TOK_FLAG_BASE_MASK));
+                value = 0;
+            } else {
+                value >>= 3;
+            }
+            break;
+
+        default: {
+            uint8_t shift = base_shift(flags);
+            if (value >> shift == 0) {
+                expression_unlink(expr, tok);
+                expr->pending = shift == 4 ? 'x' : 'b';
+                return;
+            }
+            value >>= shift;
+            break;
+        }
+    }
+
+    expression_set_literal(expr, tok, value);
+}
+
+bool
+expression_backspace(Expression *expr) {
+    TokPool *pool = &expr->tok_pool;
+
+    if (expr->pending == '<' || expr->pending == '>') {
+        expr->pending = 0;
+        return true;
+    } else if (expr->pending != 0) {
+        // Only the 0 of the prefix is left, which becomes a token again.
+        if (edit_insert(expr, TOK_INTEGER, 0, TOK_FLAG_BASE_DEC) != MATH_ERR_OK) {
             return false;
         }
+        expr->pending = 0;
+        return true;
+    } else if (expr->spaced) {
+        expr->spaced = false;
+        return true;
+    }
 
-        expression_append_token(expr, new_tok);
-        cur_pos = new_pos;
+    TokRef tok = expr->cursor;
+    if (tok == TOK_NIL) {
+        return false;
     }
 
+    TokenType type = tok_type(pool, tok);
+    if (type == TOK_INTEGER) {
+        edit_shorten(expr, tok);
+    } else {
+        expression_unlink(expr, tok);
+        if (type == TOK_BITWISE_LEFT_SHIFT) {
+            expr->pending = '<';
+        } else if (type == TOK_BITWISE_RIGHT_SHIFT) {
+            expr->pending = '>';
+        }
+    }
     return true;
 }
 
 bool
-subexpression_print(const Token *start, const Token *end) {
-    char buff[21]; // Large enough to hold UINT64_MAX.
+expression_set_cursor(Expression *expr, int pos) {
+    if (pos < 0 || (size_t)pos > expr->size || expr->pending != 0) {
+        return false;
+    }
 
-    const Token *cur_tok = start;
+    expr->cursor = pos == 0 ? TOK_NIL : expression_token_at(expr, pos - 1);
+    expr->spaced = false;
+    return true;
+}
+
+// Writes the tokens from start up to end, separated by spaces.
+static bool
+subexpression_write(const TokPool *pool, TokRef start, TokRef end, Sink *sink) {
+    static const FormatSpec decimal = {FORMAT_BASE_DEC, 0, 0, false};
+
+    TokRef cur_tok = start;
     while (cur_tok != end) {
-        if (! token_to_str(cur_tok, buff, sizeof(buff) / sizeof(buff[0]))) {
-            return false;
+        if (cur_tok != start) {
+            sink_put(sink, ' ');
         }
-        fprintf(stdout, "%s ", buff);
-        cur_tok = cur_tok->next;
+
+        TokenType type = tok_type(pool, cur_tok);
+        if (type == TOK_INTEGER) {
+            sink_write_uint(sink, tok_value(pool, cur_tok), &decimal);
+        } else {
+            char glyph[sizeof(g_operators[0].glyph)];
+            sink_write(sink, glyph, operator_glyph(type, glyph));
+        }
+        cur_tok = tok_next(pool, cur_tok);
     }
+    return ! sink->failed;
+}
 
-    fprintf(stdout, "\n");
-    return true;
+bool
+expression_write(const Expression *expr, Sink *sink) {
+    return subexpression_write(&expr->tok_pool, expr->start, TOK_NIL, sink);
 }
 
 bool
 expression_print(const Expression *expr) {
-    subexpression_print(expr->start, NULL);
+    char buff[128];
+    Sink sink;
+    sink_init(&sink, buff, sizeof(buff), sink_write_stream, stdout);
+
+    expression_write(expr, &sink);
+    sink_put(&sink, '\n');
+    return sink_flush(&sink);
 }
 
-// Evaluates an expression from [start, end).
-void
-evaluate(Token *start, Token *end) {
-    
+static bool
+is_unary(TokenType type) {
+    return (operator_arity(type) & OP_TYPE_UNARY) != 0;
 }
 
-MathErr
-expression_evaluate(Expression *expr) {
-    // Use a stack to evaluate atomic sub-expressions, I.E. parenthesis.
-    Token *eval_stack[MAX_TOKENS_PER_EXPR + 1];
-    size_t stack_idx = 0;
-
-    Token *cur_tok = expr->start;
-    while (cur_tok != NULL) {
-        if (cur_tok->type == TOK_LEFT_PARENTHESIS) {
-            // Push the start of the sub expression onto the stack.
-            eval_stack[stack_idx] = cur_tok;
-            stack_idx += 1;
-        } else if (cur_tok->type == TOK_RIGHT_PARENTHESIS) {
-            // Pop the most recent left parenthesis from the stack and evaluate
-            // the sub expression.
-            stack_idx -= 1;
+// Links operand in as the left or right operand of op. The operator goes dirty
+// if the link changes or the operand is dirty, so the cached value of any
+// sub-tree which parses the same as before survives a rebuild.
+static void
+link_operand(TokPool *pool, TokRef op, TokRef operand, bool right) {
+    TokRef old = right ? tok_right(pool, op) : tok_left(pool, op);
+    if (old != operand || (operand != TOK_NIL && is_dirty(pool, operand))) {
+        set_dirty(pool, op, true);
+    }
 
-            // If there is nothing left to pop, we have a parenthesis mismatch.
-            if (stack_idx < 0) {
-                return MATH_ERR_PARENTHESIS_MISMATCH;
-            }
+    if (right) {
+        tok_set_right(pool, op, operand);
+    } else {
+        tok_set_left(pool, op, operand);
+    }
+    if (operand != TOK_NIL) {
+        tok_set_parent(pool, operand, op);
+    }
+}
 
-            // Remove left parenthesis.
-            Token *start_paren = eval_stack[stack_idx];
-            Token *start = start_paren->next;
-            start->pre = start_paren->pre;
+// Empty parenthesis contribute nothing to an expression, so the parser steps
+// over them. Only valid once parenthesis have been matched.
+static TokRef
+skip_empty_groups(const TokPool *pool, TokRef tok, TokRef end) {
+    while (tok != end && tok_type(pool, tok) == TOK_LEFT_PARENTHESIS && tok_left(pool, tok) == TOK_NIL) {
+        tok = tok_next(pool, tok_right(pool, tok));
+    }
+    return tok;
+}
 
-            if (start_paren->pre == NULL) {
-                expr->start = start;
-            } else {
-                start->pre->next = start;
-            }
+// Parses a single operand starting at *cur: an integer or an already built
+// parenthesized group, preceded by any number of unary operators. Unary
+// operators become nodes with only a right child. On success, *cur is moved
+// past the operand.
+static MathErr
+parse_operand(TokPool *pool, TokRef *cur, TokRef end, TokRef *operand) {
+    TokRef first_unary = TOK_NIL;
+    TokRef last_unary = TOK_NIL;
+
+    TokRef tok = skip_empty_groups(pool, *cur, end);
+    while (tok != end && is_unary(tok_type(pool, tok))) {
+        link_operand(pool, tok, TOK_NIL, false);
+        if (last_unary == TOK_NIL) {
+            first_unary = tok;
+        } else {
+            link_operand(pool, last_unary, tok, true);
+        }
+        last_unary = tok;
+        tok = skip_empty_groups(pool, tok_next(pool, tok), end);
+    }
 
-            // Remove right parenthesis.
-            Token *end = cur_tok->pre;
+    if (tok == end) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
 
-            // Can be NULL if there are empty parenthesis at the start of the
-            // expression.
-            if (end != NULL) {
-                end->next = cur_tok->next;
-            } else {
-                expr->start = cur_tok->next;
+    TokRef value;
+    TokenType type = tok_type(pool, tok);
+    if (type == TOK_INTEGER) {
+        value = tok;
+        *cur = tok_next(pool, tok);
+    } else if (type == TOK_LEFT_PARENTHESIS) {
+        // The group was built when its closing parenthesis was found.
+        value = tok_left(pool, tok);
+        *cur = tok_next(pool, tok_right(pool, tok));
+    } else {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+
+    if (last_unary != TOK_NIL) {
+        link_operand(pool, last_unary, value, true);
+
+        // The chain was linked from the top down, so a dirty operator lower
+        // down is only passed up the chain now.
+        for (TokRef node = last_unary; node != first_unary; node = tok_parent(pool, node)) {
+            if (is_dirty(pool, node)) {
+                set_dirty(pool, tok_parent(pool, node), true);
             }
+        }
+        value = first_unary;
+    }
 
-            // Can be NULL if closing parenthesis at the end of the expression.
-            if (cur_tok->next != NULL) {
-                cur_tok->next->pre = end;
-            } else {
-                expr->end = end;
+    *operand = value;
+    return MATH_ERR_OK;
+}
+
+// Precedence climbing over the token list. Builds the tree for the longest run
+// of operators starting at *cur which bind at least as tight as min_prec, and
+// leaves *cur on the first token that was not consumed. Precedence and
+// associativity come from the operator table. While every operator is left
+// associative, recursion depth is bounded by the number of precedence levels
+// rather than the length of the expression.
+static MathErr
+parse_expression(TokPool *pool, TokRef *cur, TokRef end, int min_prec, TokRef *root) {
+    TokRef lhs;
+    MathErr err = parse_operand(pool, cur, end, &lhs);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    while (true) {
+        TokRef op = skip_empty_groups(pool, *cur, end);
+        *cur = op;
+        if (op == end) {
+            break;
+        }
+
+        TokenType type = tok_type(pool, op);
+        int prec = operator_precedence(type);
+        if (prec == 0) {
+            // Two operands in a row, IE "1 2" or "(1)(2)".
+            return MATH_ERR_MALFORMED_EXPR;
+        } else if (prec < min_prec) {
+            break;
+        }
+
+        TokRef rhs;
+        *cur = tok_next(pool, op);
+        int rhs_prec = operator_assoc(type) == OP_ASSOC_LEFT ? prec + 1 : prec;
+        err = parse_expression(pool, cur, end, rhs_prec, &rhs);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+
+        link_operand(pool, op, lhs, false);
+        link_operand(pool, op, rhs, true);
+        lhs = op;
+    }
+
+    *root = lhs;
+    return MATH_ERR_OK;
+}
+
+// Builds the expression tree for [start, end) in place, using the left and
+// right links of the tokens themselves. Any parenthesis in the range must
+// already be matched and built. *root is set to TOK_NIL if the range holds
+// nothing but empty parenthesis.
+static MathErr
+subexpression_build(TokPool *pool, TokRef start, TokRef end, TokRef *root) {
+    if (skip_empty_groups(pool, start, end) == end) {
+        *root = TOK_NIL;
+        return MATH_ERR_OK;
+    }
+
+    return parse_expression(pool, &start, end, 1, root);
+}
+
+#ifndef EXPR_SHUNTING_YARD
+// Literals always hold their value, and operators do while they are clean.
+static bool
+is_settled(const TokPool *pool, TokRef operand) {
+    return tok_type(pool, operand) == TOK_INTEGER || ! is_dirty(pool, operand);
+}
+
+// Evaluates a built tree in post-order. Operators which are not dirty hold the
+// value of their sub-tree, so after an edit only the dirty path is walked
+// again. A value is only cached once both operands are settled, which keeps
+// every operator above a dirty one dirty, and only if it fits the value of a
+// pooled token. Caching it also clears the marks of any changed literals
+// among the operands.
+static MathErr
+subtree_evaluate(TokPool *pool, TokRef node, uint64_t *result) {
+    TokenType type = tok_type(pool, node);
+    if (type == TOK_INTEGER || ! is_dirty(pool, node)) {
+        *result = tok_value(pool, node);
+        return MATH_ERR_OK;
+    }
+
+    uint64_t rhs;
+    TokRef right = tok_right(pool, node);
+    MathErr err = subtree_evaluate(pool, right, &rhs);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    TokRef left = tok_left(pool, node);
+    if (left == TOK_NIL) {
+        err = operator_unary(type)(0, rhs, result);
+    } else {
+        uint64_t lhs;
+        err = subtree_evaluate(pool, left, &lhs);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+        err = operator_binary(type)(lhs, rhs, result);
+    }
+
+    if (err == MATH_ERR_OK && tok_value_fits(*result) && is_settled(pool, right)
+        && (left == TOK_NIL || is_settled(pool, left))) {
+        tok_set_value(pool, node, *result);
+        set_dirty(pool, node, false);
+        set_dirty(pool, right, false);
+        if (left != TOK_NIL) {
+            set_dirty(pool, left, false);
+        }
+    }
+    return err;
+}
+#endif
+
+MathErr
+expression_build(Expression *expr) {
+    // Parenthesis are matched in a single pass, which only has to visit the
+    // parenthesis themselves. Open groups are kept on a stack threaded through
+    // the left links of the '(' tokens, so no storage beyond the token pool is
+    // needed. When a group closes, its contents are built into a sub-tree whose
+    // root replaces the stack link, and the right link of the '(' is set to the
+    // matching ')' so the group can be stepped over as a single operand. The
+    // token list itself is left untouched, so the expression can still be
+    // printed or edited afterwards.
+    TokPool *pool = &expr->tok_pool;
+    TokRef open = TOK_NIL;
+    expr->root = TOK_NIL;
+
+    TokRef cur_tok = tok_find_paren(pool, expr->start);
+    while (cur_tok != TOK_NIL) {
+        TokenType type = tok_type(pool, cur_tok);
+        if (type == TOK_LEFT_PARENTHESIS) {
+            tok_set_left(pool, cur_tok, open);
+            open = cur_tok;
+        } else if (type == TOK_RIGHT_PARENTHESIS) {
+            // If there is nothing left to pop, we have a parenthesis mismatch.
+            if (open == TOK_NIL) {
+                return MATH_ERR_PARENTHESIS_MISMATCH;
             }
 
-            // Calculate the partial tree for the sub expression.
-            if (start < end) {
-                evaluate(start, end->next);
+            TokRef start_paren = open;
+            open = tok_left(pool, start_paren);
+            tok_set_right(pool, start_paren, cur_tok);
+
+            TokRef group_root;
+            MathErr err = subexpression_build(pool, tok_next(pool, start_paren), cur_tok, &group_root);
+            if (err != MATH_ERR_OK) {
+                return err;
             }
+            tok_set_left(pool, start_paren, group_root);
         }
-    
-        cur_tok = cur_tok->next;
+
+        cur_tok = tok_find_paren(pool, tok_next(pool, cur_tok));
     }
 
-    // If there are any items in the stack once we reach the end of the
+    // If there are any groups still open once we reach the end of the
     // expression, we know there was a mismatched parenthesis.
-    if (stack_idx > 0) {
+    if (open != TOK_NIL) {
         return MATH_ERR_PARENTHESIS_MISMATCH;
     }
 
-    // Calculate the rest of the expression.
-    evaluate(expr->start, NULL);
+    // Build the rest of the expression.
+    MathErr err = subexpression_build(pool, expr->start, TOK_NIL, &expr->root);
+    if (err != MATH_ERR_OK) {
+        return err;
+    } else if (expr->root == TOK_NIL) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
 
+    tok_set_parent(pool, expr->root, TOK_NIL);
     return MATH_ERR_OK;
 }
+
+// Builds the tree, unless the last one built is still valid.
+static MathErr
+expression_ensure_built(Expression *expr) {
+    return expr->root == TOK_NIL ? expression_build(expr) : MATH_ERR_OK;
+}
+
+#ifdef EXPR_SHUNTING_YARD
+
+// Feeds the token list straight through, so the tree is never built.
+MathErr
+expression_evaluate(Expression *expr, uint64_t *result) {
+    const TokPool *pool = &expr->tok_pool;
+    Shunt shunt;
+    shunt_init(&shunt);
+
+    for (TokRef cur_tok = expr->start; cur_tok != TOK_NIL; cur_tok = tok_next(pool, cur_tok)) {
+        MathErr err = shunt_push(&shunt, tok_type(pool, cur_tok), tok_value(pool, cur_tok));
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+    }
+    return shunt_finish(&shunt, result);
+}
+
+#else
+
+MathErr
+expression_evaluate(Expression *expr, uint64_t *result) {
+    MathErr err = expression_ensure_built(expr);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    return subtree_evaluate(&expr->tok_pool, expr->root, result);
+}
+
+#endif
+
+MathErr
+expression_preview(Expression *expr, uint64_t *result) {
+    const TokPool *pool = &expr->tok_pool;
+    ExprPreview *preview = expr->preview;
+    if (preview == NULL) {
+        Shunt shunt;
+        shunt_init(&shunt);
+        for (TokRef tok = expr->start; tok != TOK_NIL; tok = tok_next(pool, tok)) {
+            if (! shunt_extend(&shunt, tok_type(pool, tok), tok_value(pool, tok))) {
+                break;
+            }
+        }
+        return shunt_finish_prefix(&shunt, NULL, result);
+    }
+
+    // Every token is fed to the kept shunt, until one of them can not continue
+    // the expression, except for a literal at the end. It may still be growing
+    // as it is typed, so it is only handed to shunt_finish_prefix, which leaves
+    // the shunt as it was.
+    TokRef next = preview->fed == TOK_NIL ? expr->start : tok_next(pool, preview->fed);
+    while (next != TOK_NIL && ! (next == expr->end && tok_type(pool, next) == TOK_INTEGER)
+           && shunt_extend(&preview->shunt, tok_type(pool, next), tok_value(pool, next))) {
+        preview->fed = next;
+        next = tok_next(pool, next);
+    }
+
+    if (next != TOK_NIL && next == expr->end && tok_type(pool, next) == TOK_INTEGER) {
+        uint64_t operand = tok_value(pool, next);
+        return shunt_finish_prefix(&preview->shunt, &operand, result);
+    }
+    return shunt_finish_prefix(&preview->shunt, NULL, result);
+}
+
+void
+expression_attach_preview(Expression *expr, ExprPreview *preview) {
+    expr->preview = preview;
+    expression_preview_reset(expr);
+}
+
+MathErr
+expression_evaluate_sized(Expression *expr, SizeMode mode, uint64_t *result) {
+    return expression_evaluate_status(expr, mode, SIGN_MODE_UNSIGNED, result, NULL);
+}
+
+MathErr
+expression_evaluate_status(Expression *expr, SizeMode mode, SignMode sign, uint64_t *result,
+                           uint8_t *flags) {
+    MathErr err = expression_ensure_built(expr);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    return number_evaluate_tree(&expr->tok_pool, expr->root, mode, sign, result, flags);
+}
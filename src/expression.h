@@ -3,26 +3,168 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #include "error.h"
+#include "number.h"
+#include "shunt.h"
+#include "sink.h"
 #include "token.h"
+#include "tok_pool.h"
 
-typedef struct Expression Expression;
+// Partial parse kept between calls to expression_preview. It is only needed by
+// expressions which are previewed, so it is provided by the caller rather than
+// being part of every Expression.
+typedef struct ExprPreview {
+    Shunt shunt;
 
+    // Last token fed to the shunt, or TOK_NIL if none has been.
+    TokRef fed;
+} ExprPreview;
+
+// The fields of an Expression are private. The struct is only defined here so
+// that callers can provide their own storage for one.
+typedef struct Expression {
+    size_t size;
+    TokPool tok_pool;
+    TokRef start;
+    TokRef end;
+
+    // Root of the expression tree, valid after a successful build.
+    TokRef root;
+
+    // Keystroke editing state. The cursor sits just after the token cursor, or
+    // at the start if it is TOK_NIL. pending holds a prefix typed at the cursor
+    // which is not a token yet, and spaced is set once whitespace is typed
+    // there.
+    TokRef cursor;
+    char pending;
+    bool spaced;
+
+    // State for expression_preview, or NULL if none is attached.
+    ExprPreview *preview;
+} Expression;
+
+// Takes one of the EXPR_CONTEXT_COUNT statically allocated expressions, each
+// holding up to MAX_TOKENS_PER_EXPR tokens, or returns NULL if they are all in
+// use. Taking and returning references is safe from any thread, or from both
+// interrupt handlers and the main loop on AVR.
 Expression * expression_take_reference();
-void expression_return_reference();
+void expression_return_reference(Expression *expr);
+
+// Bytes of arena needed for an expression of the given number of tokens.
+#define EXPR_ARENA_SIZE(tokens) TOK_ARENA_SIZE(tokens)
+
+// Prepares caller provided storage for an expression whose tokens are carved
+// out of the arena_size bytes at arena. The arena must outlive the expression.
+void expression_init(Expression *expr, void *arena, size_t arena_size);
+
+#ifndef __AVR__
+// Prepares caller provided storage for an expression whose tokens are taken
+// from the heap chunk_tokens at a time, as needed. The heap memory is kept
+// across resets, and is only released by expression_free.
+void expression_init_growable(Expression *expr, size_t chunk_tokens);
+void expression_free(Expression *expr);
+#endif
 
 bool expression_append_operator(Expression *expr, TokenType tok);
 bool expression_append_int(Expression *expr, uint64_t value);
 
+// Inserts a token before the token at pos, counting from 0, or at the end if
+// pos is the number of tokens.
 bool expression_insert_operator(Expression *expr, TokenType tok, int pos);
 bool expression_insert_int(Expression *expr, uint64_t value, int pos);
 
+// Removes the token at pos, counting from 0. Its slot is reused by the next
+// token added to the expression.
+bool expression_remove(Expression *expr, int pos);
+
+// Packs the tokens of an expression back into the front of its pool after
+// removals, so that array scans over a compact pool can be used again.
+void expression_compact(Expression *expr);
+
 void expression_reset(Expression *expr);
 
-bool expression_set_from_str(Expression *expr, const char *str);
+// Appending or parsing fails with MATH_ERR_OUT_OF_TOKENS once an expression
+// can not hold any more tokens.
+//
+// Parses an expression from the first len bytes of ptr, which does not need to
+// be null terminated. Nothing past ptr + len is ever read.
+MathErr expression_set_from_buf(Expression *expr, const char *ptr, size_t len);
+MathErr expression_set_from_str(Expression *expr, const char *str);
+
+// Edits an expression a keystroke at a time, at a cursor which sits between two
+// tokens and is left at the end by parsing. Each keystroke only touches the
+// token just before the cursor, so it costs the same however long the
+// expression is. A digit typed straight after a literal extends it in its own
+// base, IE typing f after 0x1 gives 0x1f. A prefix which is not a token yet,
+// such as 0x or the first < of <<, is held at the cursor until the next
+// character completes it.
+//
+// Literals are held as values, so leading zeros after a prefix are not kept,
+// and only whether there is whitespace before a token is, so a run of it is
+// deleted as one. Typing in the middle of an expression never joins onto the
+// token after the cursor.
+//
+// A character which can not continue the expression fails with
+// MATH_ERR_MALFORMED_EXPR, a literal growing past 64 bits with
+// MATH_ERR_LITERAL_OVERFLOW, and a full pool with MATH_ERR_OUT_OF_TOKENS. The
+// expression is unchanged by any failure.
+MathErr expression_feed_char(Expression *expr, char c);
+
+// Deletes the character before the cursor. Returns false if there is none.
+bool expression_backspace(Expression *expr);
+
+// Moves the cursor to just before the token at pos, counting from 0, or to the
+// end if pos is the number of tokens. Fails while a prefix is held.
+bool expression_set_cursor(Expression *expr, int pos);
+
+// Writes the tokens of an expression to sink, separated by single spaces. Use a
+// sink without a write callback to serialize into memory.
+bool expression_write(const Expression *expr, Sink *sink);
 bool expression_print(const Expression *expr);
 
-MathErr expression_evaluate(Expression *expr);
+// Builds the expression tree over the tokens, without evaluating it. Operator
+// tokens link to their operands through their left and right links, and unary
+// operators have no left operand. The tree stays valid until a token is next
+// added or removed, and survives edits which only change the value of a
+// literal.
+MathErr expression_build(Expression *expr);
+
+// Unless EXPR_SHUNTING_YARD is defined, each operator in the tree caches the
+// value of its sub-tree. Editing a literal only marks the path from it up to
+// the root as dirty, and rebuilding after adding or removing tokens only marks
+// the operators whose operands changed, so evaluating again only recomputes
+// the dirty operators.
+MathErr expression_evaluate(Expression *expr, uint64_t *result);
+
+// Evaluates the longest well formed start of the expression, for showing a
+// result while it is still being typed. Open parenthesis are closed, and
+// trailing operators still waiting for an operand are dropped, so
+// "(0x3F & (5 << 2" previews as 20. Any tokens from the first which can not
+// continue a well formed expression are ignored. An expression with nothing to
+// show yet fails with MATH_ERR_MALFORMED_EXPR.
+//
+// With state attached by expression_attach_preview, the partial parse is kept
+// between calls. While tokens are only added or edited at the end, each call
+// only feeds the tokens added since the last one, and then walks the stacks of
+// the groups still open, so its cost grows with how deeply the expression
+// nests rather than how long it is. Changing a token the preview has already
+// consumed, IE by deleting back past the last token, makes the next call start
+// over from the first token. Without state, every call starts over.
+MathErr expression_preview(Expression *expr, uint64_t *result);
+
+// Attaches caller provided state for expression_preview to keep, or detaches it
+// if preview is NULL. The state must outlive the attachment. Initializing an
+// expression detaches it, while resetting one keeps it attached.
+void expression_attach_preview(Expression *expr, ExprPreview *preview);
+
+// Evaluates in the width of mode, see number.h.
+MathErr expression_evaluate_sized(Expression *expr, SizeMode mode, uint64_t *result);
+
+// Evaluates in the width of mode, reading values as signed or unsigned. If
+// flags is not NULL, it is set to the NUMBER_FLAG_* status of the result.
+MathErr expression_evaluate_status(Expression *expr, SizeMode mode, SignMode sign, uint64_t *result,
+                                   uint8_t *flags);
 
 #endif
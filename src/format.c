@@ -0,0 +1,117 @@
+#include "format.h"
+#include "mul.h"
+#include "platform.h"
+
+#include <string.h>
+
+static const char hex_digits[16] PROGMEM = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+};
+
+// Each converter below writes the digits of value backwards, ending just before
+// end, and returns where the most significant digit starts. Zero is written as
+// a single digit.
+
+// Division by 10 is a multiply by its reciprocal: n / 10 is the product of n
+// and ceil(2^(w + 3) / 10) shifted right by w + 3, for every n of w bits. The
+// leading digits of a large value are few, so the value is moved down to the
+// narrowest width it fits as soon as it can, where an AVR has to do far less
+// work per multiply.
+//
+// Since the digit is less than 10, the low bytes of the value and quotient are
+// enough to find it, which saves multiplying back out the whole quotient.
+static char *
+format_dec(uint64_t value, char *end) {
+    while (value > UINT32_MAX) {
+        uint64_t quotient = mul_u64_high(value, 0xCCCCCCCCCCCCCCCD) >> 3;
+        *--end = (char)('0' + (uint8_t)((uint8_t)value - (uint8_t)quotient * 10));
+        value = quotient;
+    }
+
+    uint32_t dword = (uint32_t)value;
+    while (dword > UINT16_MAX) {
+        uint32_t quotient = mul_u32_high(dword, 0xCCCCCCCD) >> 3;
+        *--end = (char)('0' + (uint8_t)((uint8_t)dword - (uint8_t)quotient * 10));
+        dword = quotient;
+    }
+
+    uint16_t word = (uint16_t)dword;
+    do {
+        uint16_t quotient = (uint16_t)(mul_u16_wide(word, 0xCCCD) >> 19);
+        *--end = (char)('0' + (uint8_t)((uint8_t)word - (uint8_t)quotient * 10));
+        word = quotient;
+    } while (word != 0);
+
+    return end;
+}
+
+// Binary and hexadecimal digits never straddle a byte, so value is taken apart
+// a byte at a time and its digits are shifted out of that. Shifting value by
+// whole bytes only moves registers around on AVR.
+static char *
+format_bytewise(uint64_t value, uint8_t bits, char *end) {
+    uint8_t mask = (uint8_t)((1 << bits) - 1);
+    while (true) {
+        uint8_t byte = (uint8_t)value;
+        value >>= 8;
+        for (uint8_t i = 0; i < 8; i += bits) {
+            *--end = (char)PROGMEM_READ_BYTE(&hex_digits[byte & mask]);
+            byte >>= bits;
+            if (byte == 0 && value == 0) {
+                return end;
+            }
+        }
+    }
+}
+
+static char *
+format_oct(uint64_t value, char *end) {
+    do {
+        *--end = (char)('0' + ((uint8_t)value & 7));
+        value >>= 3;
+    } while (value != 0);
+    return end;
+}
+
+size_t
+format_uint(uint64_t value, const FormatSpec *spec, char *buff, size_t buff_size) {
+    char digits[64];
+    char *end = digits + sizeof(digits);
+    char *start;
+    const char *prefix;
+
+    switch (spec->base) {
+        case FORMAT_BASE_BIN: start = format_bytewise(value, 1, end); prefix = "0b"; break;
+        case FORMAT_BASE_OCT: start = format_oct(value, end); prefix = "0"; break;
+        case FORMAT_BASE_HEX: start = format_bytewise(value, 4, end); prefix = "0x"; break;
+        default: start = format_dec(value, end); prefix = ""; break;
+    }
+
+    // An octal zero is already marked by its leading 0.
+    size_t prefix_len = spec->prefix && (spec->base != FORMAT_BASE_OCT || value != 0) ? strlen(prefix) : 0;
+    size_t count = (size_t)(end - start);
+    size_t separators = spec->group == 0 ? 0 : (count - 1) / spec->group;
+    size_t len = prefix_len + count + separators;
+    if (len >= buff_size) {
+        return 0;
+    }
+
+    memcpy(buff, prefix, prefix_len);
+    char *out = buff + prefix_len;
+
+    // Only the leading group can be short.
+    size_t run = count - separators * spec->group;
+    while (true) {
+        memcpy(out, start, run);
+        out += run;
+        start += run;
+        if (start == end) {
+            break;
+        }
+        *out++ = spec->separator;
+        run = spec->group;
+    }
+
+    *out = '\0';
+    return len;
+}
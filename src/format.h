@@ -0,0 +1,37 @@
+#ifndef _FORMAT_H
+#define _FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Formats integers without printf, which on AVR costs kilobytes of flash and
+// works through 64 bit values one slow division at a time.
+
+typedef enum FormatBase {
+    FORMAT_BASE_BIN = 2,
+    FORMAT_BASE_OCT = 8,
+    FORMAT_BASE_DEC = 10,
+    FORMAT_BASE_HEX = 16
+} FormatBase;
+
+// Digits are grouped from the least significant end, IE 1,000,000 or
+// 0b1010_0101, by putting separator between every group digits. A group of 0
+// leaves them ungrouped. If prefix is set, the base is marked the same way the
+// lexer reads it: 0b, 0 or 0x.
+typedef struct FormatSpec {
+    FormatBase base;
+    uint8_t group;
+    char separator;
+    bool prefix;
+} FormatSpec;
+
+// Large enough for any 64 bit value in any format: 64 binary digits with a
+// separator between each of them, the prefix and the null terminator.
+#define FORMAT_BUFF_SIZE (2 + 64 + 63 + 1)
+
+// Writes value to buff as a null terminated string, and returns its length. If
+// it would not fit in buff_size bytes, nothing is written and 0 is returned.
+size_t format_uint(uint64_t value, const FormatSpec *spec, char *buff, size_t buff_size);
+
+#endif // _FORMAT_H
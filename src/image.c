@@ -0,0 +1,241 @@
+#include "image.h"
+#include "operator.h"
+#include "platform.h"
+
+#define IMAGE_MAGIC_0 'E'
+#define IMAGE_MAGIC_1 'X'
+#define IMAGE_HEADER_FIXED 4
+
+// Literals below this fit in the opcode byte.
+#define IMAGE_SMALL_LITERAL 0x80
+
+// Longest a 64 bit varint can be.
+#define VARINT_MAX_BYTES 10
+
+// Writes value as a varint at out, unless out is NULL, and returns its length.
+static size_t
+write_varint(uint64_t value, uint8_t *out) {
+    size_t len = 0;
+    do {
+        uint8_t byte = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        if (out != NULL) {
+            out[len] = byte;
+        }
+        len += 1;
+    } while (value != 0);
+    return len;
+}
+
+// Re-encodes the code of a compiled program at out, unless out is NULL, and
+// returns its length. The program is trusted, having come from the compiler.
+static size_t
+pack_code(const Bytecode *code, uint8_t *out) {
+    size_t len = 0;
+    const uint8_t *pc = code->code;
+    const uint8_t *end = pc + code->size;
+    while (pc != end) {
+        uint8_t opcode = *pc++;
+        size_t bytes = 0;
+        switch (opcode) {
+            case OPC_PUSH8: bytes = 1; break;
+            case OPC_PUSH16: bytes = 2; break;
+            case OPC_PUSH32: bytes = 4; break;
+            case OPC_PUSH64: bytes = 8; break;
+        }
+
+        if (bytes == 0) {
+            if (out != NULL) {
+                out[len] = opcode;
+            }
+            len += 1;
+            continue;
+        }
+
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= (uint64_t)pc[i] << (8 * i);
+        }
+        pc += bytes;
+
+        if (value < IMAGE_SMALL_LITERAL) {
+            if (out != NULL) {
+                out[len] = (uint8_t)(IMAGE_SMALL_LITERAL | value);
+            }
+            len += 1;
+        } else {
+            if (out != NULL) {
+                out[len] = OPC_PUSH8;
+            }
+            len += 1 + write_varint(value, out == NULL ? NULL : out + len + 1);
+        }
+    }
+    return len;
+}
+
+MathErr
+image_save(const Bytecode *code, uint8_t *buff, size_t capacity, size_t *size) {
+    if (code->size == 0) {
+        return MATH_ERR_MALFORMED_EXPR;
+    } else if (code->depth > UINT8_MAX) {
+        return MATH_ERR_STACK_OVERFLOW;
+    }
+
+    size_t code_len = pack_code(code, NULL);
+    size_t header_len = IMAGE_HEADER_FIXED + write_varint(code_len, NULL);
+    if (capacity < header_len + code_len) {
+        return MATH_ERR_OUT_OF_CODE;
+    }
+
+    buff[0] = IMAGE_MAGIC_0;
+    buff[1] = IMAGE_MAGIC_1;
+    buff[2] = IMAGE_VERSION;
+    buff[3] = (uint8_t)code->depth;
+    write_varint(code_len, buff + IMAGE_HEADER_FIXED);
+    pack_code(code, buff + header_len);
+
+    *size = header_len + code_len;
+    return MATH_ERR_OK;
+}
+
+static inline uint8_t
+read_byte(ImageSpace space, const uint8_t *addr) {
+    switch (space) {
+        case IMAGE_SPACE_FLASH: return PROGMEM_READ_BYTE(addr);
+        case IMAGE_SPACE_EEPROM: return EEPROM_READ_BYTE(addr);
+        default: return *addr;
+    }
+}
+
+// Reads a varint at *pc without going past end, and moves *pc past it.
+static MathErr
+read_varint(ImageSpace space, const uint8_t **pc, const uint8_t *end, uint64_t *value) {
+    uint64_t val = 0;
+    for (uint8_t shift = 0; shift < 7 * VARINT_MAX_BYTES; shift += 7) {
+        if (*pc == end) {
+            return MATH_ERR_MALFORMED_EXPR;
+        }
+
+        uint8_t byte = read_byte(space, (*pc)++);
+        uint64_t bits = byte & 0x7F;
+
+        // The last byte of a 64 bit varint only has room for a single bit.
+        if (shift == 63 && bits > 1) {
+            return MATH_ERR_MALFORMED_EXPR;
+        }
+        val |= bits << shift;
+
+        if ((byte & 0x80) == 0) {
+            *value = val;
+            return MATH_ERR_OK;
+        }
+    }
+    return MATH_ERR_MALFORMED_EXPR;
+}
+
+MathErr
+image_load(ExprImage *image, const uint8_t *data, size_t size, ImageSpace space) {
+    if (size < IMAGE_HEADER_FIXED
+        || read_byte(space, data) != IMAGE_MAGIC_0
+        || read_byte(space, data + 1) != IMAGE_MAGIC_1
+        || read_byte(space, data + 2) != IMAGE_VERSION) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+
+    uint8_t depth = read_byte(space, data + 3);
+    if (depth > EXPR_VM_STACK_DEPTH) {
+        return MATH_ERR_STACK_OVERFLOW;
+    }
+
+    const uint8_t *pc = data + IMAGE_HEADER_FIXED;
+    const uint8_t *end = data + size;
+    uint64_t code_len;
+    MathErr err = read_varint(space, &pc, end, &code_len);
+    if (err != MATH_ERR_OK) {
+        return err;
+    } else if (code_len == 0 || code_len > (uint64_t)(end - pc)) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+
+    image->code = pc;
+    image->size = (size_t)code_len;
+    image->depth = depth;
+    image->space = space;
+    return MATH_ERR_OK;
+}
+
+// Same machine as bytecode_run, keeping the top of the stack in tos. Since the
+// code comes from outside, every instruction also checks the stack holds its
+// operands, and that pushes stay within the depth given in the header.
+MathErr
+image_run(const ExprImage *image, uint64_t *result) {
+    uint64_t stack[EXPR_VM_STACK_DEPTH];
+    size_t sp = 0;
+    uint64_t tos = 0;
+
+    if (image->depth > EXPR_VM_STACK_DEPTH) {
+        return MATH_ERR_STACK_OVERFLOW;
+    }
+
+    const uint8_t *pc = image->code;
+    const uint8_t *end = pc + image->size;
+    while (pc != end) {
+        MathErr err;
+        uint8_t opcode = read_byte(image->space, pc++);
+
+        if (opcode >= IMAGE_SMALL_LITERAL || opcode == OPC_PUSH8) {
+            if (sp == image->depth) {
+                return MATH_ERR_STACK_OVERFLOW;
+            }
+            stack[sp++] = tos;
+
+            if (opcode == OPC_PUSH8) {
+                err = read_varint(image->space, &pc, end, &tos);
+                if (err != MATH_ERR_OK) {
+                    return err;
+                }
+            } else {
+                tos = opcode & (IMAGE_SMALL_LITERAL - 1);
+            }
+            continue;
+        }
+
+        if (opcode == OPC_NOT || opcode == OPC_NEG) {
+            if (sp < 1) {
+                return MATH_ERR_MALFORMED_EXPR;
+            }
+            err = opcode == OPC_NOT ? operation_bitwise_not(0, tos, &tos) : operation_negate(0, tos, &tos);
+        } else {
+            if (sp < 2) {
+                return MATH_ERR_MALFORMED_EXPR;
+            }
+            uint64_t lhs = stack[--sp];
+            switch (opcode) {
+                case OPC_MUL: err = operation_multiply(lhs, tos, &tos); break;
+                case OPC_DIV: err = operation_divide(lhs, tos, &tos); break;
+                case OPC_MOD: err = operation_modulo(lhs, tos, &tos); break;
+                case OPC_ADD: err = operation_add(lhs, tos, &tos); break;
+                case OPC_SUB: err = operation_subtract(lhs, tos, &tos); break;
+                case OPC_SHL: err = operation_shift_left(lhs, tos, &tos); break;
+                case OPC_SHR: err = operation_shift_right(lhs, tos, &tos); break;
+                case OPC_AND: err = operation_bitwise_and(lhs, tos, &tos); break;
+                case OPC_XOR: err = operation_bitwise_xor(lhs, tos, &tos); break;
+                case OPC_OR: err = operation_bitwise_or(lhs, tos, &tos); break;
+                default: return MATH_ERR_MALFORMED_EXPR;
+            }
+        }
+
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+    }
+
+    if (sp != 1) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+    *result = tos;
+    return MATH_ERR_OK;
+}
@@ -0,0 +1,62 @@
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bytecode.h"
+#include "error.h"
+
+// A compiled expression saved as a self contained binary image, which can be
+// kept in EEPROM or flash on AVR, or in a file on the host, and run in place
+// without being parsed or copied anywhere first.
+//
+// An image starts with a header:
+//
+//  * The magic bytes 'E' 'X', then IMAGE_VERSION.
+//  * The most values the stack holds while running, in one byte.
+//  * The length of the code in bytes, as a varint.
+//
+// The code is the stack machine program of bytecode.h, packed tighter. Operator
+// opcodes are unchanged, a byte with the top bit set pushes the literal in its
+// low 7 bits, and OPC_PUSH8 pushes the literal in the varint after it. Varints
+// are little endian groups of 7 bits, with the top bit of each byte set on all
+// but the last.
+#define IMAGE_VERSION 1
+
+// Bytes needed to be sure an expression of the given number of tokens will
+// save. A literal takes up to 11 bytes, and the header up to 14.
+#define IMAGE_SIZE(tokens) (14 + (tokens) * 11)
+
+// Where an image is kept, which decides how its bytes are read.
+typedef enum ImageSpace {
+    IMAGE_SPACE_RAM,
+    IMAGE_SPACE_FLASH,
+    IMAGE_SPACE_EEPROM
+} ImageSpace;
+
+// A loaded image. It only points at the image data, which must stay where it is
+// for as long as the image is run.
+typedef struct ExprImage {
+    const uint8_t *code;
+    size_t size;
+    uint8_t depth;
+    ImageSpace space;
+} ExprImage;
+
+// Saves a compiled program into capacity bytes at buff, and sets *size to the
+// length of the image. Fails with MATH_ERR_OUT_OF_CODE if it does not fit.
+MathErr image_save(const Bytecode *code, uint8_t *buff, size_t capacity, size_t *size);
+
+// Checks the header of the image in the first size bytes at data, and points
+// image at its code. Fails with MATH_ERR_MALFORMED_EXPR if the data is not an
+// image of this version, or MATH_ERR_STACK_OVERFLOW if running it would need
+// more than EXPR_VM_STACK_DEPTH values.
+MathErr image_load(ExprImage *image, const uint8_t *data, size_t size, ImageSpace space);
+
+// Runs a loaded image, giving the same result as the program it was saved
+// from. The code is checked as it runs, so a corrupt image fails with
+// MATH_ERR_MALFORMED_EXPR rather than misbehaving.
+MathErr image_run(const ExprImage *image, uint64_t *result);
+
+#endif // _IMAGE_H
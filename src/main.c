@@ -1,8 +1,33 @@
 // Test program.
 
 #include <stdio.h>
+#include <inttypes.h>
 
+#include "bytecode.h"
 #include "expression.h"
+#include "format.h"
+#include "sink.h"
+
+// Results are shown in every base at once.
+static const FormatSpec g_result_formats[] = {
+    {FORMAT_BASE_DEC, 3, ',', false},
+    {FORMAT_BASE_HEX, 4, '_', true},
+    {FORMAT_BASE_OCT, 0, 0, true},
+    {FORMAT_BASE_BIN, 4, '_', true},
+};
+
+static void
+print_result(uint64_t value) {
+    char buff[128];
+    Sink sink;
+    sink_init(&sink, buff, sizeof(buff), sink_write_stream, stdout);
+    for (size_t i = 0; i < sizeof(g_result_formats) / sizeof(g_result_formats[0]); i++) {
+        sink_write_str(&sink, "  ");
+        sink_write_uint(&sink, value, &g_result_formats[i]);
+        sink_put(&sink, '\n');
+    }
+    sink_flush(&sink);
+}
 
 int main(int argc, char *argv[]) {
     Expression *expr = expression_take_reference();
@@ -11,12 +36,25 @@ int main(int argc, char *argv[]) {
     expression_append_int(expr, 37);
     expression_print(expr);
 
-    if (! expression_set_from_str(expr, "()1+2+()3*(5+2)()")) {
+    if (expression_set_from_str(expr, "()1+2+()3*(5+2)()") != MATH_ERR_OK) {
         fprintf(stdout, "Expression parse error!\n");
     }
     expression_print(expr);
 
-    MathErr res = expression_evaluate(expr);
-    fprintf(stdout, "Result: %d\n", res);
+    uint64_t value;
+    MathErr res = expression_evaluate(expr, &value);
+    fprintf(stdout, "Result: %d, %" PRIu64 "\n", res, value);
     expression_print(expr);
+
+    static uint8_t code_buff[BYTECODE_SIZE(MAX_TOKENS_PER_EXPR)];
+    Bytecode code;
+    bytecode_init(&code, code_buff, sizeof(code_buff));
+    res = expression_compile(expr, &code);
+    if (res == MATH_ERR_OK) {
+        res = bytecode_run(&code, &value);
+    }
+    fprintf(stdout, "Compiled result: %d, %" PRIu64 "\n", res, value);
+    if (res == MATH_ERR_OK) {
+        print_result(value);
+    }
 }
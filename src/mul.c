@@ -0,0 +1,79 @@
+#include "mul.h"
+
+// Each width is split into two halves, lhs = lhs_hi * 2^n + lhs_lo and likewise
+// for rhs, giving the four partial products lo * lo, lo * hi, hi * lo and
+// hi * hi. A truncated product never needs hi * hi, and only needs the low
+// half of the two cross products.
+
+uint32_t
+mul_u32_low(uint32_t lhs, uint32_t rhs) {
+    uint16_t lhs_lo = (uint16_t)lhs;
+    uint16_t lhs_hi = (uint16_t)(lhs >> 16);
+    uint16_t rhs_lo = (uint16_t)rhs;
+    uint16_t rhs_hi = (uint16_t)(rhs >> 16);
+
+    // Multiplying as unsigned int keeps the uint16_t operands from being
+    // promoted to a signed int, which could overflow.
+    unsigned int cross = (unsigned int)lhs_lo * rhs_hi + (unsigned int)lhs_hi * rhs_lo;
+    return mul_u16_wide(lhs_lo, rhs_lo) + ((uint32_t)(uint16_t)cross << 16);
+}
+
+uint64_t
+mul_u32_wide(uint32_t lhs, uint32_t rhs) {
+    uint16_t lhs_lo = (uint16_t)lhs;
+    uint16_t lhs_hi = (uint16_t)(lhs >> 16);
+    uint16_t rhs_lo = (uint16_t)rhs;
+    uint16_t rhs_hi = (uint16_t)(rhs >> 16);
+
+    uint32_t lo_lo = mul_u16_wide(lhs_lo, rhs_lo);
+    uint32_t lo_hi = mul_u16_wide(lhs_lo, rhs_hi);
+    uint32_t hi_lo = mul_u16_wide(lhs_hi, rhs_lo);
+    uint32_t hi_hi = mul_u16_wide(lhs_hi, rhs_hi);
+
+    // Summing the middle column in 32 bits could carry out, so the carry is
+    // kept separately.
+    uint32_t middle = (lo_lo >> 16) + (uint16_t)lo_hi + (uint16_t)hi_lo;
+    uint32_t low = (uint16_t)lo_lo | (middle << 16);
+    uint32_t high = hi_hi + (lo_hi >> 16) + (hi_lo >> 16) + (middle >> 16);
+    return ((uint64_t)high << 32) | low;
+}
+
+uint32_t
+mul_u32_high(uint32_t lhs, uint32_t rhs) {
+    return (uint32_t)(mul_u32_wide(lhs, rhs) >> 32);
+}
+
+uint64_t
+mul_u64_low(uint64_t lhs, uint64_t rhs) {
+    uint32_t lhs_lo = (uint32_t)lhs;
+    uint32_t lhs_hi = (uint32_t)(lhs >> 32);
+    uint32_t rhs_lo = (uint32_t)rhs;
+    uint32_t rhs_hi = (uint32_t)(rhs >> 32);
+
+    uint32_t cross = mul_u32_low(lhs_lo, rhs_hi) + mul_u32_low(lhs_hi, rhs_lo);
+    return mul_u32_wide(lhs_lo, rhs_lo) + ((uint64_t)cross << 32);
+}
+
+void
+mul_u64_wide(uint64_t lhs, uint64_t rhs, uint64_t *high, uint64_t *low) {
+    uint32_t lhs_lo = (uint32_t)lhs;
+    uint32_t lhs_hi = (uint32_t)(lhs >> 32);
+    uint32_t rhs_lo = (uint32_t)rhs;
+    uint32_t rhs_hi = (uint32_t)(rhs >> 32);
+
+    uint64_t lo_lo = mul_u32_wide(lhs_lo, rhs_lo);
+    uint64_t lo_hi = mul_u32_wide(lhs_lo, rhs_hi);
+    uint64_t hi_lo = mul_u32_wide(lhs_hi, rhs_lo);
+    uint64_t hi_hi = mul_u32_wide(lhs_hi, rhs_hi);
+
+    uint64_t middle = (lo_lo >> 32) + (uint32_t)lo_hi + (uint32_t)hi_lo;
+    *low = (uint32_t)lo_lo | (middle << 32);
+    *high = hi_hi + (lo_hi >> 32) + (hi_lo >> 32) + (middle >> 32);
+}
+
+uint64_t
+mul_u64_high(uint64_t lhs, uint64_t rhs) {
+    uint64_t high, low;
+    mul_u64_wide(lhs, rhs, &high, &low);
+    return high;
+}
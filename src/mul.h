@@ -0,0 +1,69 @@
+#ifndef _MUL_H
+#define _MUL_H
+
+#include <stdint.h>
+
+// Unsigned multiplies built up from a 16 by 16 bit multiply, giving either the
+// product truncated to the width of the operands, or the full double width
+// product, or just its high half.
+//
+// AVR only multiplies 8 bits at a time. The compiler's 64 bit multiply ignores
+// that and runs the same generic routine whatever the operands, so here the
+// 16 bit multiply is hand written from four MUL instructions, and the wider
+// ones only compute the partial products they need. Everywhere else the same
+// C code is built on the native multiply, which lets the host tests check it.
+
+#if defined(__AVR__) && defined(__AVR_HAVE_MUL__)
+
+static inline uint32_t
+mul_u16_wide(uint16_t lhs, uint16_t rhs) {
+    uint32_t product;
+    uint8_t zero;
+
+    // Schoolbook multiply of the bytes. Each MUL leaves its product in r1:r0,
+    // and r1 has to be cleared again afterwards since the compiler expects it
+    // to always hold zero.
+    __asm__ (
+        "clr %[zero]\n\t"
+        "mul %B[lhs], %B[rhs]\n\t"
+        "movw %C[product], r0\n\t"
+        "mul %A[lhs], %A[rhs]\n\t"
+        "movw %A[product], r0\n\t"
+        "mul %B[lhs], %A[rhs]\n\t"
+        "add %B[product], r0\n\t"
+        "adc %C[product], r1\n\t"
+        "adc %D[product], %[zero]\n\t"
+        "mul %A[lhs], %B[rhs]\n\t"
+        "add %B[product], r0\n\t"
+        "adc %C[product], r1\n\t"
+        "adc %D[product], %[zero]\n\t"
+        "clr __zero_reg__"
+        : [product] "=&r" (product), [zero] "=&r" (zero)
+        : [lhs] "r" (lhs), [rhs] "r" (rhs)
+        : "r0");
+    return product;
+}
+
+#else
+
+static inline uint32_t
+mul_u16_wide(uint16_t lhs, uint16_t rhs) {
+    return (uint32_t)lhs * rhs;
+}
+
+#endif
+
+static inline uint16_t
+mul_u16_high(uint16_t lhs, uint16_t rhs) {
+    return (uint16_t)(mul_u16_wide(lhs, rhs) >> 16);
+}
+
+uint32_t mul_u32_low(uint32_t lhs, uint32_t rhs);
+uint64_t mul_u32_wide(uint32_t lhs, uint32_t rhs);
+uint32_t mul_u32_high(uint32_t lhs, uint32_t rhs);
+
+uint64_t mul_u64_low(uint64_t lhs, uint64_t rhs);
+void mul_u64_wide(uint64_t lhs, uint64_t rhs, uint64_t *high, uint64_t *low);
+uint64_t mul_u64_high(uint64_t lhs, uint64_t rhs);
+
+#endif // _MUL_H
@@ -0,0 +1,249 @@
+#include "number.h"
+#include "mul.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// GCC 5 and clang provide checked arithmetic which hands back the carry or
+// overflow of an operation along with its result.
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define NUMBER_OVERFLOW_BUILTINS 1
+#endif
+
+// AVR has no divide instruction, and the libgcc routines always work through
+// every bit of the width. Define NUMBER_SOFT_DIVIDE to use the same shift and
+// subtract division elsewhere.
+#if defined(__AVR__) && !defined(NUMBER_SOFT_DIVIDE)
+#define NUMBER_SOFT_DIVIDE 1
+#endif
+
+// The libgcc multiplies on AVR work out the whole product even though only its
+// low half is kept, so the 32 and 64 bit widths use the truncated multiplies
+// from mul.h instead.
+#if defined(__AVR__) && defined(__AVR_HAVE_MUL__)
+#define NUMBER_HW_MUL 1
+#endif
+
+#define NUMBER_BITS 8
+#define NUMBER_T uint8_t
+#define NUMBER_ST int8_t
+#define NUMBER_WORK_T unsigned int
+#define NUMBER_FN(name) name##_u8
+#define NUMBER_MUL(lhs, rhs) ((NUMBER_T)((NUMBER_WORK_T)(lhs) * (rhs)))
+#include "number_width.h"
+#undef NUMBER_BITS
+#undef NUMBER_T
+#undef NUMBER_ST
+#undef NUMBER_WORK_T
+#undef NUMBER_FN
+#undef NUMBER_MUL
+
+#define NUMBER_BITS 16
+#define NUMBER_T uint16_t
+#define NUMBER_ST int16_t
+#define NUMBER_WORK_T unsigned int
+#define NUMBER_FN(name) name##_u16
+#define NUMBER_MUL(lhs, rhs) ((NUMBER_T)((NUMBER_WORK_T)(lhs) * (rhs)))
+#include "number_width.h"
+#undef NUMBER_BITS
+#undef NUMBER_T
+#undef NUMBER_ST
+#undef NUMBER_WORK_T
+#undef NUMBER_FN
+#undef NUMBER_MUL
+
+#define NUMBER_BITS 32
+#define NUMBER_T uint32_t
+#define NUMBER_ST int32_t
+#define NUMBER_WORK_T uint32_t
+#define NUMBER_FN(name) name##_u32
+#ifdef NUMBER_HW_MUL
+#define NUMBER_MUL(lhs, rhs) mul_u32_low(lhs, rhs)
+#else
+#define NUMBER_MUL(lhs, rhs) ((NUMBER_T)((NUMBER_WORK_T)(lhs) * (rhs)))
+#endif
+#include "number_width.h"
+#undef NUMBER_BITS
+#undef NUMBER_T
+#undef NUMBER_ST
+#undef NUMBER_WORK_T
+#undef NUMBER_FN
+#undef NUMBER_MUL
+
+#define NUMBER_BITS 64
+#define NUMBER_T uint64_t
+#define NUMBER_ST int64_t
+#define NUMBER_WORK_T uint64_t
+#define NUMBER_FN(name) name##_u64
+#ifdef NUMBER_HW_MUL
+#define NUMBER_MUL(lhs, rhs) mul_u64_low(lhs, rhs)
+#else
+#define NUMBER_MUL(lhs, rhs) ((NUMBER_T)((NUMBER_WORK_T)(lhs) * (rhs)))
+#endif
+#include "number_width.h"
+#undef NUMBER_BITS
+#undef NUMBER_T
+#undef NUMBER_ST
+#undef NUMBER_WORK_T
+#undef NUMBER_FN
+#undef NUMBER_MUL
+
+void
+number_set_from_uint(Token *num, uint64_t value) {
+    token_reset(num);
+    token_set_integer(num, value);
+}
+
+uint64_t
+number_truncate(uint64_t value, SizeMode mode) {
+    switch (mode) {
+        case SIZE_MODE_BYTE: return (uint8_t)value;
+        case SIZE_MODE_WORD: return (uint16_t)value;
+        case SIZE_MODE_DWORD: return (uint32_t)value;
+        default: return value;
+    }
+}
+
+MathErr
+number_apply(TokenType type, const Token *lhs, const Token *rhs, Token *result, SizeMode mode,
+             SignMode sign, uint8_t *flags) {
+    MathErr err;
+    uint64_t value = 0;
+    switch (mode) {
+        case SIZE_MODE_BYTE: {
+            uint8_t narrow = 0;
+            err = flags == NULL ? binary_u8(type, sign, (uint8_t)VAL(lhs), (uint8_t)VAL(rhs), &narrow)
+                                : binary_flags_u8(type, sign, (uint8_t)VAL(lhs), (uint8_t)VAL(rhs), &narrow, flags);
+            value = narrow;
+            break;
+        }
+        case SIZE_MODE_WORD: {
+            uint16_t narrow = 0;
+            err = flags == NULL ? binary_u16(type, sign, (uint16_t)VAL(lhs), (uint16_t)VAL(rhs), &narrow)
+                                : binary_flags_u16(type, sign, (uint16_t)VAL(lhs), (uint16_t)VAL(rhs), &narrow, flags);
+            value = narrow;
+            break;
+        }
+        case SIZE_MODE_DWORD: {
+            uint32_t narrow = 0;
+            err = flags == NULL ? binary_u32(type, sign, (uint32_t)VAL(lhs), (uint32_t)VAL(rhs), &narrow)
+                                : binary_flags_u32(type, sign, (uint32_t)VAL(lhs), (uint32_t)VAL(rhs), &narrow, flags);
+            value = narrow;
+            break;
+        }
+        default:
+            err = flags == NULL ? binary_u64(type, sign, VAL(lhs), VAL(rhs), &value)
+                                : binary_flags_u64(type, sign, VAL(lhs), VAL(rhs), &value, flags);
+            break;
+    }
+
+    if (err == MATH_ERR_OK) {
+        number_set_from_uint(result, value);
+    }
+    return err;
+}
+
+MathErr
+number_divmod(const Token *lhs, const Token *rhs, Token *quotient, Token *remainder, SizeMode mode,
+              SignMode sign) {
+    MathErr err;
+    uint64_t quotient_value = 0;
+    uint64_t remainder_value = 0;
+    switch (mode) {
+        case SIZE_MODE_BYTE: {
+            uint8_t narrow_quotient = 0, narrow_remainder = 0;
+            err = divmod_u8((uint8_t)VAL(lhs), (uint8_t)VAL(rhs), sign, &narrow_quotient, &narrow_remainder);
+            quotient_value = narrow_quotient;
+            remainder_value = narrow_remainder;
+            break;
+        }
+        case SIZE_MODE_WORD: {
+            uint16_t narrow_quotient = 0, narrow_remainder = 0;
+            err = divmod_u16((uint16_t)VAL(lhs), (uint16_t)VAL(rhs), sign, &narrow_quotient, &narrow_remainder);
+            quotient_value = narrow_quotient;
+            remainder_value = narrow_remainder;
+            break;
+        }
+        case SIZE_MODE_DWORD: {
+            uint32_t narrow_quotient = 0, narrow_remainder = 0;
+            err = divmod_u32((uint32_t)VAL(lhs), (uint32_t)VAL(rhs), sign, &narrow_quotient, &narrow_remainder);
+            quotient_value = narrow_quotient;
+            remainder_value = narrow_remainder;
+            break;
+        }
+        default:
+            err = divmod_u64(VAL(lhs), VAL(rhs), sign, &quotient_value, &remainder_value);
+            break;
+    }
+
+    if (err == MATH_ERR_OK) {
+        number_set_from_uint(quotient, quotient_value);
+        number_set_from_uint(remainder, remainder_value);
+    }
+    return err;
+}
+
+void
+number_udivmod(uint64_t lhs, uint64_t rhs, uint64_t *quotient, uint64_t *remainder) {
+    udivmod_u64(lhs, rhs, quotient, remainder);
+}
+
+MathErr
+number_add(const Token *lhs, const Token *rhs, Token *result, SizeMode mode) {
+    return number_apply(TOK_PLUS, lhs, rhs, result, mode, SIGN_MODE_UNSIGNED, NULL);
+}
+
+MathErr
+number_sub(const Token *lhs, const Token *rhs, Token *result, SizeMode mode) {
+    return number_apply(TOK_MINUS, lhs, rhs, result, mode, SIGN_MODE_UNSIGNED, NULL);
+}
+
+MathErr
+number_mul(const Token *lhs, const Token *rhs, Token *result, SizeMode mode) {
+    return number_apply(TOK_TIMES, lhs, rhs, result, mode, SIGN_MODE_UNSIGNED, NULL);
+}
+
+MathErr
+number_div(const Token *lhs, const Token *rhs, Token *result, SizeMode mode) {
+    return number_apply(TOK_DIVIDED_BY, lhs, rhs, result, mode, SIGN_MODE_UNSIGNED, NULL);
+}
+
+MathErr
+number_mod(const Token *lhs, const Token *rhs, Token *result, SizeMode mode) {
+    return number_apply(TOK_MODULO, lhs, rhs, result, mode, SIGN_MODE_UNSIGNED, NULL);
+}
+
+MathErr
+number_evaluate_tree(const TokPool *pool, TokRef root, SizeMode mode, SignMode sign, uint64_t *result,
+                     uint8_t *flags) {
+    MathErr err;
+    uint64_t value = 0;
+    switch (mode) {
+        case SIZE_MODE_BYTE: {
+            uint8_t narrow = 0;
+            err = tree_evaluate_u8(pool, root, sign, &narrow, flags);
+            value = narrow;
+            break;
+        }
+        case SIZE_MODE_WORD: {
+            uint16_t narrow = 0;
+            err = tree_evaluate_u16(pool, root, sign, &narrow, flags);
+            value = narrow;
+            break;
+        }
+        case SIZE_MODE_DWORD: {
+            uint32_t narrow = 0;
+            err = tree_evaluate_u32(pool, root, sign, &narrow, flags);
+            value = narrow;
+            break;
+        }
+        default:
+            err = tree_evaluate_u64(pool, root, sign, &value, flags);
+            break;
+    }
+
+    if (err == MATH_ERR_OK) {
+        *result = value;
+    }
+    return err;
+}
@@ -0,0 +1,73 @@
+#ifndef _NUMBER_H
+#define _NUMBER_H
+
+#include <stdint.h>
+
+#include "error.h"
+#include "tok_pool.h"
+#include "token.h"
+
+// Width of the unsigned integers a calculation is done in. Every result wraps
+// around at the width, and operands wider than it are truncated first, as C
+// conversions would.
+//
+// Each width has its own code path working on the native type, so in byte mode
+// an AVR only ever touches 8 bit registers and 8 bit libgcc helpers, rather
+// than paying for 64 bit arithmetic and masking the result.
+typedef enum SizeMode {
+    SIZE_MODE_BYTE,
+    SIZE_MODE_WORD,
+    SIZE_MODE_DWORD,
+    SIZE_MODE_QWORD
+} SizeMode;
+
+// How values are read by the operators which care: division, modulo and right
+// shifts. Every other operator gives the same bits either way.
+typedef enum SignMode {
+    SIGN_MODE_UNSIGNED,
+    SIGN_MODE_SIGNED
+} SignMode;
+
+// Status flags of a result, in the same bits as the AVR status register.
+#define NUMBER_FLAG_CARRY 0x01
+#define NUMBER_FLAG_ZERO 0x02
+#define NUMBER_FLAG_NEGATIVE 0x04
+#define NUMBER_FLAG_OVERFLOW 0x08
+
+// The value held by an integer token.
+#define VAL(tok) ((tok)->value)
+
+void number_set_from_uint(Token *num, uint64_t value);
+
+// Truncates value to the width of mode.
+uint64_t number_truncate(uint64_t value, SizeMode mode);
+
+// Arithmetic on integer tokens in the width of mode. Division fails with
+// MATH_ERR_DIV_BY_ZERO, leaving result untouched.
+MathErr number_add(const Token *lhs, const Token *rhs, Token *result, SizeMode mode);
+MathErr number_sub(const Token *lhs, const Token *rhs, Token *result, SizeMode mode);
+MathErr number_mul(const Token *lhs, const Token *rhs, Token *result, SizeMode mode);
+MathErr number_div(const Token *lhs, const Token *rhs, Token *result, SizeMode mode);
+MathErr number_mod(const Token *lhs, const Token *rhs, Token *result, SizeMode mode);
+
+// Divides once for both the quotient and the remainder.
+MathErr number_divmod(const Token *lhs, const Token *rhs, Token *quotient, Token *remainder, SizeMode mode,
+                      SignMode sign);
+
+// Unsigned 64 bit division by a non-zero rhs, by the same routine as
+// number_divmod, so it is shift and subtract wherever NUMBER_SOFT_DIVIDE is
+// defined. The operator table divides through it.
+void number_udivmod(uint64_t lhs, uint64_t rhs, uint64_t *quotient, uint64_t *remainder);
+
+// Applies any binary operator. If flags is not NULL, it is set to the status
+// flags of the result, which are only worked out when asked for.
+MathErr number_apply(TokenType type, const Token *lhs, const Token *rhs, Token *result, SizeMode mode,
+                     SignMode sign, uint8_t *flags);
+
+// Evaluates a tree built by expression_build in the width of mode. The width is
+// picked once, and the whole tree is then walked by the code for that width.
+// If flags is not NULL, it is set to the status flags of the final operation.
+MathErr number_evaluate_tree(const TokPool *pool, TokRef root, SizeMode mode, SignMode sign, uint64_t *result,
+                             uint8_t *flags);
+
+#endif // _NUMBER_H
@@ -0,0 +1,357 @@
+// Arithmetic and tree evaluation for a single width. number.c includes this once
+// per width, so there is deliberately no include guard. Before each inclusion
+// it defines:
+//
+//  * NUMBER_BITS, the width.
+//  * NUMBER_T, the unsigned type of that width, and NUMBER_ST the signed one.
+//  * NUMBER_WORK_T, the type to do arithmetic in, which is at least an unsigned
+//    int so that narrow operands are never promoted to a signed int.
+//  * NUMBER_FN(name), the name of a function for this width.
+//  * NUMBER_MUL(lhs, rhs), the product of two NUMBER_T truncated to the width.
+//
+// Values are always held as NUMBER_T. In signed mode they are only read as
+// two's complement by the operators where that makes a difference.
+
+#define NUMBER_SIGN_BIT ((NUMBER_T)1 << (NUMBER_BITS - 1))
+
+static inline NUMBER_T
+NUMBER_FN(shift_left)(NUMBER_T lhs, NUMBER_T rhs) {
+    // Shifting by the width or more is undefined in C, but every bit has been
+    // shifted out by then.
+    return rhs >= NUMBER_BITS ? 0 : (NUMBER_T)((NUMBER_WORK_T)lhs << rhs);
+}
+
+static inline NUMBER_T
+NUMBER_FN(shift_right)(NUMBER_T lhs, NUMBER_T rhs, SignMode sign) {
+    if (sign == SIGN_MODE_UNSIGNED || (lhs & NUMBER_SIGN_BIT) == 0) {
+        return rhs >= NUMBER_BITS ? 0 : (NUMBER_T)(lhs >> rhs);
+    }
+
+    // Arithmetic shift, filling with copies of the sign bit.
+    return rhs >= NUMBER_BITS ? (NUMBER_T)~(NUMBER_T)0 : (NUMBER_T)~(NUMBER_T)((NUMBER_T)~lhs >> rhs);
+}
+
+static MathErr
+NUMBER_FN(unary)(TokenType type, NUMBER_T rhs, NUMBER_T *result) {
+    switch (type) {
+        case TOK_BITWISE_NOT: *result = (NUMBER_T)~(NUMBER_WORK_T)rhs; return MATH_ERR_OK;
+        case TOK_MINUS: *result = (NUMBER_T)-(NUMBER_WORK_T)rhs; return MATH_ERR_OK;
+        case TOK_PLUS: *result = rhs; return MATH_ERR_OK;
+        default: return MATH_ERR_MALFORMED_EXPR;
+    }
+}
+
+// Unsigned division, giving both the quotient and the remainder. Without a
+// hardware divider it is done by shift and subtract, aligning the divisor with
+// the top of the dividend first so that only as many steps are taken as there
+// are bits of difference between them, rather than one per bit of the width.
+static inline void
+NUMBER_FN(udivmod)(NUMBER_T lhs, NUMBER_T rhs, NUMBER_T *quotient, NUMBER_T *remainder) {
+#ifdef NUMBER_SOFT_DIVIDE
+    NUMBER_T divisor = rhs;
+    NUMBER_T bit = 1;
+    while (divisor <= (NUMBER_T)(lhs >> 1)) {
+        divisor = (NUMBER_T)(divisor << 1);
+        bit = (NUMBER_T)(bit << 1);
+    }
+
+    NUMBER_T result = 0;
+    while (bit != 0) {
+        if (lhs >= divisor) {
+            lhs = (NUMBER_T)(lhs - divisor);
+            result |= bit;
+        }
+        divisor >>= 1;
+        bit >>= 1;
+    }
+
+    *quotient = result;
+    *remainder = lhs;
+#else
+    // Both come out of a single divide instruction.
+    *quotient = lhs / rhs;
+    *remainder = lhs % rhs;
+#endif
+}
+
+// Fused division and modulo. Signed division truncates toward zero, as in C,
+// and the remainder takes the sign of the dividend. Dividing the most negative
+// value by -1 wraps back around to it, rather than being undefined.
+static MathErr
+NUMBER_FN(divmod)(NUMBER_T lhs, NUMBER_T rhs, SignMode sign, NUMBER_T *quotient, NUMBER_T *remainder) {
+    if (rhs == 0) {
+        return MATH_ERR_DIV_BY_ZERO;
+    }
+
+    if (sign == SIGN_MODE_UNSIGNED) {
+        NUMBER_FN(udivmod)(lhs, rhs, quotient, remainder);
+        return MATH_ERR_OK;
+    }
+
+    bool lhs_negative = (lhs & NUMBER_SIGN_BIT) != 0;
+    bool rhs_negative = (rhs & NUMBER_SIGN_BIT) != 0;
+    NUMBER_T lhs_mag = lhs_negative ? (NUMBER_T)-(NUMBER_WORK_T)lhs : lhs;
+    NUMBER_T rhs_mag = rhs_negative ? (NUMBER_T)-(NUMBER_WORK_T)rhs : rhs;
+
+    NUMBER_T quotient_mag, remainder_mag;
+    NUMBER_FN(udivmod)(lhs_mag, rhs_mag, &quotient_mag, &remainder_mag);
+    *quotient = lhs_negative != rhs_negative ? (NUMBER_T)-(NUMBER_WORK_T)quotient_mag : quotient_mag;
+    *remainder = lhs_negative ? (NUMBER_T)-(NUMBER_WORK_T)remainder_mag : remainder_mag;
+    return MATH_ERR_OK;
+}
+
+static MathErr
+NUMBER_FN(divide)(TokenType type, NUMBER_T lhs, NUMBER_T rhs, SignMode sign, NUMBER_T *result) {
+    NUMBER_T quotient, remainder;
+    MathErr err = NUMBER_FN(divmod)(lhs, rhs, sign, &quotient, &remainder);
+    if (err == MATH_ERR_OK) {
+        *result = type == TOK_DIVIDED_BY ? quotient : remainder;
+    }
+    return err;
+}
+
+static MathErr
+NUMBER_FN(binary)(TokenType type, SignMode sign, NUMBER_T lhs, NUMBER_T rhs, NUMBER_T *result) {
+    NUMBER_WORK_T a = lhs;
+    NUMBER_WORK_T b = rhs;
+    switch (type) {
+        case TOK_TIMES: *result = NUMBER_MUL(lhs, rhs); return MATH_ERR_OK;
+        case TOK_DIVIDED_BY:
+        case TOK_MODULO: return NUMBER_FN(divide)(type, lhs, rhs, sign, result);
+        case TOK_PLUS: *result = (NUMBER_T)(a + b); return MATH_ERR_OK;
+        case TOK_MINUS: *result = (NUMBER_T)(a - b); return MATH_ERR_OK;
+        case TOK_BITWISE_LEFT_SHIFT: *result = NUMBER_FN(shift_left)(lhs, rhs); return MATH_ERR_OK;
+        case TOK_BITWISE_RIGHT_SHIFT: *result = NUMBER_FN(shift_right)(lhs, rhs, sign); return MATH_ERR_OK;
+        case TOK_BITWISE_AND: *result = lhs & rhs; return MATH_ERR_OK;
+        case TOK_BITWISE_XOR: *result = lhs ^ rhs; return MATH_ERR_OK;
+        case TOK_BITWISE_OR: *result = lhs | rhs; return MATH_ERR_OK;
+        default: return MATH_ERR_MALFORMED_EXPR;
+    }
+}
+
+static inline uint8_t
+NUMBER_FN(value_flags)(NUMBER_T value) {
+    uint8_t flags = 0;
+    if (value == 0) {
+        flags |= NUMBER_FLAG_ZERO;
+    }
+    if ((value & NUMBER_SIGN_BIT) != 0) {
+        flags |= NUMBER_FLAG_NEGATIVE;
+    }
+    return flags;
+}
+
+// Like the shifts on AVR, the overflow flag of a shift is N ^ C.
+static inline uint8_t
+NUMBER_FN(shift_flags)(uint8_t flags) {
+    bool negative = (flags & NUMBER_FLAG_NEGATIVE) != 0;
+    bool carry = (flags & NUMBER_FLAG_CARRY) != 0;
+    return negative != carry ? flags | NUMBER_FLAG_OVERFLOW : flags;
+}
+
+// Same as unary, but also works out the flags of the result, following the
+// matching AVR instruction: COM always sets carry, and NEG sets it for any
+// result but zero.
+static MathErr
+NUMBER_FN(unary_flags)(TokenType type, NUMBER_T rhs, NUMBER_T *result, uint8_t *flags) {
+    MathErr err = NUMBER_FN(unary)(type, rhs, result);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    uint8_t value_flags = NUMBER_FN(value_flags)(*result);
+    if (type == TOK_BITWISE_NOT) {
+        value_flags |= NUMBER_FLAG_CARRY;
+    } else if (type == TOK_MINUS) {
+        if (*result != 0) {
+            value_flags |= NUMBER_FLAG_CARRY;
+        }
+        if (*result == NUMBER_SIGN_BIT) {
+            value_flags |= NUMBER_FLAG_OVERFLOW;
+        }
+    }
+
+    *flags = value_flags;
+    return MATH_ERR_OK;
+}
+
+// Same as binary, but also works out the flags of the result. Carry is the
+// unsigned carry or borrow out of the operation, and overflow is set when the
+// result does not fit as a signed value.
+static MathErr
+NUMBER_FN(binary_flags)(TokenType type, SignMode sign, NUMBER_T lhs, NUMBER_T rhs, NUMBER_T *result,
+                        uint8_t *flags) {
+    NUMBER_T value;
+    bool carry = false;
+    bool overflow = false;
+    bool shift = false;
+
+    switch (type) {
+#if defined(NUMBER_OVERFLOW_BUILTINS) && !defined(__AVR__)
+        case TOK_PLUS: {
+            NUMBER_ST signed_value;
+            carry = __builtin_add_overflow(lhs, rhs, &value);
+            overflow = __builtin_add_overflow((NUMBER_ST)lhs, (NUMBER_ST)rhs, &signed_value);
+            break;
+        }
+        case TOK_MINUS: {
+            NUMBER_ST signed_value;
+            carry = __builtin_sub_overflow(lhs, rhs, &value);
+            overflow = __builtin_sub_overflow((NUMBER_ST)lhs, (NUMBER_ST)rhs, &signed_value);
+            break;
+        }
+#else
+        // Written so that the compiler can read the carry straight from the
+        // carry chain of the add or subtract.
+        case TOK_PLUS:
+            value = (NUMBER_T)((NUMBER_WORK_T)lhs + rhs);
+            carry = value < lhs;
+            overflow = ((lhs ^ value) & (rhs ^ value) & NUMBER_SIGN_BIT) != 0;
+            break;
+        case TOK_MINUS:
+            value = (NUMBER_T)((NUMBER_WORK_T)lhs - rhs);
+            carry = lhs < rhs;
+            overflow = ((lhs ^ rhs) & (lhs ^ value) & NUMBER_SIGN_BIT) != 0;
+            break;
+#endif
+
+#ifdef NUMBER_OVERFLOW_BUILTINS
+        case TOK_TIMES: {
+            NUMBER_ST signed_value;
+            carry = __builtin_mul_overflow(lhs, rhs, &value);
+            overflow = __builtin_mul_overflow((NUMBER_ST)lhs, (NUMBER_ST)rhs, &signed_value);
+            break;
+        }
+#else
+        case TOK_TIMES: {
+            value = NUMBER_MUL(lhs, rhs);
+            carry = lhs != 0 && value / lhs != rhs;
+
+            NUMBER_ST a = (NUMBER_ST)lhs;
+            NUMBER_ST b = (NUMBER_ST)rhs;
+            if (a == -1) {
+                overflow = rhs == NUMBER_SIGN_BIT;
+            } else if (a != 0) {
+                overflow = b == -1 ? lhs == NUMBER_SIGN_BIT : (NUMBER_ST)value / a != b;
+            }
+            break;
+        }
+#endif
+
+        case TOK_DIVIDED_BY:
+        case TOK_MODULO: {
+            MathErr err = NUMBER_FN(divide)(type, lhs, rhs, sign, &value);
+            if (err != MATH_ERR_OK) {
+                return err;
+            }
+            overflow = sign == SIGN_MODE_SIGNED && type == TOK_DIVIDED_BY && lhs == NUMBER_SIGN_BIT
+                       && rhs == (NUMBER_T)~(NUMBER_T)0;
+            break;
+        }
+
+        // The carry of a shift is the last bit shifted out.
+        case TOK_BITWISE_LEFT_SHIFT:
+            value = NUMBER_FN(shift_left)(lhs, rhs);
+            carry = rhs != 0 && rhs <= NUMBER_BITS && ((lhs >> (NUMBER_BITS - rhs)) & 1) != 0;
+            shift = true;
+            break;
+        case TOK_BITWISE_RIGHT_SHIFT:
+            value = NUMBER_FN(shift_right)(lhs, rhs, sign);
+            if (rhs != 0) {
+                NUMBER_T last_out = rhs <= NUMBER_BITS ? NUMBER_FN(shift_right)(lhs, rhs - 1, sign) : value;
+                carry = (last_out & 1) != 0;
+            }
+            shift = true;
+            break;
+
+        default: {
+            MathErr err = NUMBER_FN(binary)(type, sign, lhs, rhs, &value);
+            if (err != MATH_ERR_OK) {
+                return err;
+            }
+            break;
+        }
+    }
+
+    uint8_t value_flags = NUMBER_FN(value_flags)(value);
+    if (carry) {
+        value_flags |= NUMBER_FLAG_CARRY;
+    }
+    if (overflow) {
+        value_flags |= NUMBER_FLAG_OVERFLOW;
+    }
+    if (shift) {
+        value_flags = NUMBER_FN(shift_flags)(value_flags);
+    }
+
+    *result = value;
+    *flags = value_flags;
+    return MATH_ERR_OK;
+}
+
+// Evaluates a built tree in post-order, the same way subtree_evaluate in
+// expression.c does, with every intermediate value held in NUMBER_T.
+static MathErr
+NUMBER_FN(subtree_evaluate)(const TokPool *pool, TokRef node, SignMode sign, NUMBER_T *result) {
+    TokenType type = tok_type(pool, node);
+    if (type == TOK_INTEGER) {
+        *result = (NUMBER_T)tok_value(pool, node);
+        return MATH_ERR_OK;
+    }
+
+    NUMBER_T rhs;
+    MathErr err = NUMBER_FN(subtree_evaluate)(pool, tok_right(pool, node), sign, &rhs);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    TokRef left = tok_left(pool, node);
+    if (left == TOK_NIL) {
+        return NUMBER_FN(unary)(type, rhs, result);
+    }
+
+    NUMBER_T lhs;
+    err = NUMBER_FN(subtree_evaluate)(pool, left, sign, &lhs);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    return NUMBER_FN(binary)(type, sign, lhs, rhs, result);
+}
+
+// Flags only describe the final result, so they are only worked out for the
+// root of the tree, and not at all unless they are asked for.
+static MathErr
+NUMBER_FN(tree_evaluate)(const TokPool *pool, TokRef root, SignMode sign, NUMBER_T *result, uint8_t *flags) {
+    if (flags == NULL) {
+        return NUMBER_FN(subtree_evaluate)(pool, root, sign, result);
+    }
+
+    TokenType type = tok_type(pool, root);
+    if (type == TOK_INTEGER) {
+        *result = (NUMBER_T)tok_value(pool, root);
+        *flags = NUMBER_FN(value_flags)(*result);
+        return MATH_ERR_OK;
+    }
+
+    NUMBER_T rhs;
+    MathErr err = NUMBER_FN(subtree_evaluate)(pool, tok_right(pool, root), sign, &rhs);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    TokRef left = tok_left(pool, root);
+    if (left == TOK_NIL) {
+        return NUMBER_FN(unary_flags)(type, rhs, result, flags);
+    }
+
+    NUMBER_T lhs;
+    err = NUMBER_FN(subtree_evaluate)(pool, left, sign, &lhs);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    return NUMBER_FN(binary_flags)(type, sign, lhs, rhs, result, flags);
+}
+
+#undef NUMBER_SIGN_BIT
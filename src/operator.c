@@ -1,29 +1,33 @@
 
 #include <stdint.h>
 
-#include "error.h"
+#include "number.h"
+#include "operator.h"
 
 MathErr
-operation_noop(uint64_t op1, uint64_t *result) {
-    *result = op1;
+operation_noop(uint64_t lhs, uint64_t rhs, uint64_t *result) {
+    (void)lhs;
+    *result = rhs;
     return MATH_ERR_OK;
 }
 
 MathErr
-operation_bitwise_not(uint64_t op1, uint64_t *result) {
-    *result = ~op1;
+operation_bitwise_not(uint64_t lhs, uint64_t rhs, uint64_t *result) {
+    (void)lhs;
+    *result = ~rhs;
     return MATH_ERR_OK;
 }
 
 MathErr
-operation_negate(uint64_t op1, uint64_t *result) {
-    *result = -op1;
+operation_negate(uint64_t lhs, uint64_t rhs, uint64_t *result) {
+    (void)lhs;
+    *result = -rhs;
     return MATH_ERR_OK;
 }
 
 MathErr
 operation_multiply(uint64_t op1, uint64_t op2, uint64_t *result) {
-    return op1 * op2;
+    *result = op1 * op2;
     return MATH_ERR_OK;
 }
 
@@ -32,8 +36,9 @@ operation_divide(uint64_t op1, uint64_t op2, uint64_t *result) {
     if (op2 == 0) {
         return MATH_ERR_DIV_BY_ZERO;
     }
-    
-    *result = op1 / op2;
+
+    uint64_t remainder;
+    number_udivmod(op1, op2, result, &remainder);
     return MATH_ERR_OK;
 }
 
@@ -43,7 +48,8 @@ operation_modulo(uint64_t op1, uint64_t op2, uint64_t *result) {
         return MATH_ERR_DIV_BY_ZERO;
     }
 
-    *result = op1 % op2;
+    uint64_t quotient;
+    number_udivmod(op1, op2, &quotient, result);
     return MATH_ERR_OK;
 }
 
@@ -59,17 +65,17 @@ operation_subtract(uint64_t op1, uint64_t op2, uint64_t *result) {
     return MATH_ERR_OK;
 }
 
-// TODO: Return an error on negative shifts.
+// Shifting by 64 or more is undefined in C, but every bit has been shifted out
+// by then. Negative counts are huge unsigned ones, so they give 0 too.
 MathErr
 operation_shift_left(uint64_t op1, uint64_t op2, uint64_t *result) {
-    *result = op1 << op2;
+    *result = op2 >= 64 ? 0 : op1 << op2;
     return MATH_ERR_OK;
 }
 
-// TODO: Return an error on negative shifts.
 MathErr
 operation_shift_right(uint64_t op1, uint64_t op2, uint64_t *result) {
-    *result = op1 >> op2;
+    *result = op2 >= 64 ? 0 : op1 >> op2;
     return MATH_ERR_OK;
 }
 
@@ -89,4 +95,30 @@ MathErr
 operation_bitwise_or(uint64_t op1, uint64_t op2, uint64_t *result) {
     *result = op1 | op2;
     return MATH_ERR_OK;
-}
\ No newline at end of file
+}
+
+#define UNARY(func, text) \
+    { func, NULL, 0, OP_ASSOC_LEFT, OP_TYPE_UNARY, text }
+#define BINARY(func, prec, text) \
+    { NULL, func, prec, OP_ASSOC_LEFT, OP_TYPE_BINARY, text }
+#define EITHER(unary_func, binary_func, prec, text) \
+    { unary_func, binary_func, prec, OP_ASSOC_LEFT, OP_TYPE_UNARY | OP_TYPE_BINARY, text }
+#define OTHER(text) \
+    { NULL, NULL, 0, OP_ASSOC_LEFT, 0, text }
+
+const Operator g_operators[TOK_TYPE_COUNT] PROGMEM = {
+    [TOK_LEFT_PARENTHESIS] = OTHER("("),
+    [TOK_RIGHT_PARENTHESIS] = OTHER(")"),
+    [TOK_BITWISE_NOT] = UNARY(operation_bitwise_not, "~"),
+    [TOK_TIMES] = BINARY(operation_multiply, 6, "*"),
+    [TOK_DIVIDED_BY] = BINARY(operation_divide, 6, "/"),
+    [TOK_MODULO] = BINARY(operation_modulo, 6, "%"),
+    [TOK_PLUS] = EITHER(operation_noop, operation_add, 5, "+"),
+    [TOK_MINUS] = EITHER(operation_negate, operation_subtract, 5, "-"),
+    [TOK_BITWISE_LEFT_SHIFT] = BINARY(operation_shift_left, 4, "<<"),
+    [TOK_BITWISE_RIGHT_SHIFT] = BINARY(operation_shift_right, 4, ">>"),
+    [TOK_BITWISE_AND] = BINARY(operation_bitwise_and, 3, "&"),
+    [TOK_BITWISE_XOR] = BINARY(operation_bitwise_xor, 2, "^"),
+    [TOK_BITWISE_OR] = BINARY(operation_bitwise_or, 1, "|"),
+    [TOK_INTEGER] = OTHER(""),
+};
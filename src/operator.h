@@ -1,22 +1,100 @@
 #ifndef _OPERATOR_H
 #define _OPERATOR_H
 
+#include <stdint.h>
+#include <stddef.h>
+
+#include "error.h"
+#include "platform.h"
 #include "token.h"
 
+// Every operation shares one signature so they can be reached through the
+// operator table. Unary operations only use rhs, which matches the tree, where
+// a unary operator keeps its operand in its right link.
+typedef MathErr (*OpFunc)(uint64_t lhs, uint64_t rhs, uint64_t *result);
+
+// Flags for the ways a token can be used as an operator. Some tokens, IE '-',
+// can be used both ways.
 typedef enum OpType {
-    OP_TYPE_UNARY,
-    OP_TYPE_BINARY
-} OperatorType;
+    OP_TYPE_UNARY = 0x01,
+    OP_TYPE_BINARY = 0x02
+} OpType;
 
 typedef enum OpAssociativity {
     OP_ASSOC_LEFT,
     OP_ASSOC_RIGHT
 } OpAssociativity;
 
+// Describes the operator a token type stands for. Parenthesis and integers
+// have entries too, with no arity, so any TokenType can be looked up.
 typedef struct Operator {
-    TokenType token;
-    OpType type;
-    OpAssociativity assoc;
+    OpFunc unary;
+    OpFunc binary;
+
+    // Binding strength as a binary operator, following C. Higher values bind
+    // tighter, and 0 means the token is not a binary operator.
+    uint8_t precedence;
+    uint8_t assoc;
+    uint8_t arity;
+
+    // Text of the token, null terminated.
+    char glyph[3];
 } Operator;
 
+// Indexed by TokenType. Kept in flash on AVR, so it must only be read through
+// the accessors below.
+extern const Operator g_operators[TOK_TYPE_COUNT] PROGMEM;
+
+static inline uint8_t
+operator_precedence(TokenType type) {
+    return PROGMEM_READ_BYTE(&g_operators[type].precedence);
+}
+
+static inline OpAssociativity
+operator_assoc(TokenType type) {
+    return (OpAssociativity)PROGMEM_READ_BYTE(&g_operators[type].assoc);
+}
+
+static inline uint8_t
+operator_arity(TokenType type) {
+    return PROGMEM_READ_BYTE(&g_operators[type].arity);
+}
+
+static inline OpFunc
+operator_unary(TokenType type) {
+    return (OpFunc)PROGMEM_READ_PTR(&g_operators[type].unary);
+}
+
+static inline OpFunc
+operator_binary(TokenType type) {
+    return (OpFunc)PROGMEM_READ_PTR(&g_operators[type].binary);
+}
+
+// Copies the glyph of a token type into buff, which must hold at least
+// sizeof(g_operators[0].glyph) bytes. Returns the length of the glyph.
+static inline size_t
+operator_glyph(TokenType type, char *buff) {
+    size_t len = 0;
+    while ((buff[len] = (char)PROGMEM_READ_BYTE(&g_operators[type].glyph[len])) != '\0') {
+        len += 1;
+    }
+    return len;
+}
+
+MathErr operation_noop(uint64_t lhs, uint64_t rhs, uint64_t *result);
+MathErr operation_bitwise_not(uint64_t lhs, uint64_t rhs, uint64_t *result);
+MathErr operation_negate(uint64_t lhs, uint64_t rhs, uint64_t *result);
+
+MathErr operation_multiply(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_divide(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_modulo(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_add(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_subtract(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_shift_left(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_shift_right(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_bitwise_and(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_bitwise_xor(uint64_t op1, uint64_t op2, uint64_t *result);
+MathErr operation_bitwise_or(uint64_t op1, uint64_t op2, uint64_t *result);
+
 #endif // _OPERATOR_H
+
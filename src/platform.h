@@ -0,0 +1,36 @@
+#ifndef _PLATFORM_H
+#define _PLATFORM_H
+
+#include <stdint.h>
+
+// Constant lookup tables are kept in flash on AVR, where they would otherwise
+// be copied into SRAM at startup, and must be read back with the pgm_read_*
+// family. Everywhere else they are ordinary const data.
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define PROGMEM_READ_BYTE(addr) pgm_read_byte(addr)
+#define PROGMEM_READ_PTR(addr) pgm_read_ptr(addr)
+#else
+#define PROGMEM
+#define PROGMEM_READ_BYTE(addr) (*(const uint8_t *)(addr))
+#define PROGMEM_READ_PTR(addr) (*(addr))
+#endif
+
+// Data can also be kept in EEPROM on AVR, which has its own read routine. Hosts
+// have no EEPROM, so anything standing in for it is plain memory, IE a mapped
+// file.
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#define EEPROM_READ_BYTE(addr) eeprom_read_byte(addr)
+#else
+#define EEPROM_READ_BYTE(addr) (*(const uint8_t *)(addr))
+#endif
+
+// Little endian hosts can treat 8 bytes of a string or table as one 64 bit word
+// and work on all of them at once (SWAR). AVR has no use for this, since its
+// registers are only 8 bits wide.
+#if !defined(__AVR__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PLATFORM_SWAR 1
+#endif
+
+#endif // _PLATFORM_H
@@ -0,0 +1,326 @@
+#include "regcode.h"
+#include "mul.h"
+#include "operator.h"
+#include "tok_pool.h"
+
+#if EXPR_VM_STACK_DEPTH > 256
+#error "Registers are numbered with a byte, so EXPR_VM_STACK_DEPTH can be at most 256."
+#endif
+
+// Running a division by a reciprocal needs the high half of a 64 by 64 bit
+// multiply.
+static inline uint64_t
+mul_high(uint64_t lhs, uint64_t rhs) {
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)lhs * rhs) >> 64);
+#else
+    return mul_u64_high(lhs, rhs);
+#endif
+}
+
+// Returns floor(high * 2^64 / divisor), for high < divisor, by long division.
+// Only used while compiling, so there is no need for it to be fast.
+static uint64_t
+div_wide(uint64_t high, uint64_t divisor) {
+    uint64_t quotient = 0;
+    for (int i = 0; i < 64; i++) {
+        bool carry = (high >> 63) != 0;
+        high <<= 1;
+        quotient <<= 1;
+        if (carry || high >= divisor) {
+            high -= divisor;
+            quotient |= 1;
+        }
+    }
+    return quotient;
+}
+
+void
+regcode_init(RegCode *code, RegInstr *buff, size_t capacity) {
+    code->code = buff;
+    code->size = 0;
+    code->capacity = capacity;
+    code->registers = 0;
+}
+
+static MathErr
+emit(RegCode *code, RegOpcode opcode, size_t dst, uint64_t imm) {
+    if (code->size == code->capacity) {
+        return MATH_ERR_OUT_OF_CODE;
+    } else if (dst >= EXPR_VM_STACK_DEPTH) {
+        return MATH_ERR_STACK_OVERFLOW;
+    }
+
+    RegInstr *instr = &code->code[code->size++];
+    instr->imm = imm;
+    instr->opcode = (uint8_t)opcode;
+    instr->dst = (uint8_t)dst;
+    instr->src = (uint8_t)(dst + 1);
+
+    if (dst + 1 > code->registers) {
+        code->registers = dst + 1;
+    }
+    return MATH_ERR_OK;
+}
+
+// Register form of each binary operator. The immediate form follows at the
+// same distance for all of them.
+static RegOpcode
+binary_opcode(TokenType type) {
+    switch (type) {
+        case TOK_TIMES: return ROP_MUL;
+        case TOK_DIVIDED_BY: return ROP_DIV;
+        case TOK_MODULO: return ROP_MOD;
+        case TOK_PLUS: return ROP_ADD;
+        case TOK_MINUS: return ROP_SUB;
+        case TOK_BITWISE_LEFT_SHIFT: return ROP_SHL;
+        case TOK_BITWISE_RIGHT_SHIFT: return ROP_SHR;
+        case TOK_BITWISE_AND: return ROP_AND;
+        case TOK_BITWISE_XOR: return ROP_XOR;
+        case TOK_BITWISE_OR: return ROP_OR;
+        default: return ROP_HALT;
+    }
+}
+
+// Emits a binary operator whose right operand is the literal rhs.
+static MathErr
+emit_immediate(RegCode *code, RegOpcode opcode, size_t dst, uint64_t rhs) {
+    bool is_divide = opcode == ROP_DIV || opcode == ROP_MOD;
+    if (! is_divide || rhs <= 1) {
+        // Division by zero is left to fail at run time.
+        return emit(code, opcode + (ROP_MUL_IMM - ROP_MUL), dst, rhs);
+    }
+
+    if ((rhs & (rhs - 1)) == 0) {
+        uint64_t shift = 0;
+        while (((uint64_t)1 << shift) != rhs) {
+            shift += 1;
+        }
+        return opcode == ROP_DIV ? emit(code, ROP_SHR_IMM, dst, shift) : emit(code, ROP_AND_IMM, dst, rhs - 1);
+    }
+
+    // Round-up method from Granlund and Montgomery. With l = ceil(log2(rhs)),
+    // and the magic m = floor(2^64 * (2^l - rhs) / rhs) + 1, the quotient is
+    // (t + ((n - t) >> 1)) >> (l - 1) where t is the high half of m * n. The
+    // halving keeps the sum from overflowing for any n.
+    uint64_t log2 = 0;
+    for (uint64_t bits = rhs - 1; bits != 0; bits >>= 1) {
+        log2 += 1;
+    }
+    uint64_t excess = log2 == 64 ? 0 - rhs : ((uint64_t)1 << log2) - rhs;
+    uint64_t magic = div_wide(excess, rhs) + 1;
+
+    MathErr err = emit(code, opcode == ROP_DIV ? ROP_DIV_MAGIC : ROP_MOD_MAGIC, dst, magic);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+    code->code[code->size - 1].src = (uint8_t)(log2 - 1);
+
+    if (opcode == ROP_MOD) {
+        return emit(code, ROP_HALT, dst, rhs);
+    }
+    return MATH_ERR_OK;
+}
+
+// Emits code leaving the value of a built tree in register dst. Registers are
+// handed out like stack slots: the right operand of a binary operator goes in
+// the register after its left one, unless it is a literal, which is folded
+// into the operator instead.
+static MathErr
+subtree_compile(const TokPool *pool, TokRef node, RegCode *code, size_t dst) {
+    TokenType type = tok_type(pool, node);
+    if (type == TOK_INTEGER) {
+        return emit(code, ROP_LOAD, dst, tok_value(pool, node));
+    }
+
+    MathErr err;
+    TokRef left = tok_left(pool, node);
+    TokRef right = tok_right(pool, node);
+    if (left == TOK_NIL) {
+        err = subtree_compile(pool, right, code, dst);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+
+        switch (type) {
+            case TOK_BITWISE_NOT: return emit(code, ROP_NOT, dst, 0);
+            case TOK_MINUS: return emit(code, ROP_NEG, dst, 0);
+            case TOK_PLUS: return MATH_ERR_OK;
+            default: return MATH_ERR_MALFORMED_EXPR;
+        }
+    }
+
+    RegOpcode opcode = binary_opcode(type);
+    if (opcode == ROP_HALT) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+
+    err = subtree_compile(pool, left, code, dst);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    if (tok_type(pool, right) == TOK_INTEGER) {
+        return emit_immediate(code, opcode, dst, tok_value(pool, right));
+    }
+
+    err = subtree_compile(pool, right, code, dst + 1);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+    return emit(code, opcode, dst, 0);
+}
+
+MathErr
+expression_compile_regcode(Expression *expr, RegCode *code) {
+    code->size = 0;
+    code->registers = 0;
+
+    MathErr err = expression_build(expr);
+    if (err == MATH_ERR_OK) {
+        err = subtree_compile(&expr->tok_pool, expr->root, code, 0);
+    }
+    if (err == MATH_ERR_OK) {
+        err = emit(code, ROP_HALT, 0, 0);
+    }
+
+    if (err != MATH_ERR_OK) {
+        code->size = 0;
+        code->registers = 0;
+    }
+    return err;
+}
+
+// On GCC and clang, each handler jumps straight to the next one through a table
+// of label addresses, so every handler gets its own indirect branch to predict.
+// Elsewhere it falls back to a switch in a loop.
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#endif
+
+#ifdef VM_THREADED
+#define VM_CASE(name) do_##name:
+#define VM_NEXT() goto *dispatch[(++ip)->opcode]
+#else
+#define VM_CASE(name) case ROP_##name:
+#define VM_NEXT() ip++; continue
+#endif
+
+// Every operator goes through its operation_* routine, so results and errors
+// are the same as for any other evaluator.
+#define VM_BINARY(name, operation) \
+    VM_CASE(name) \
+        err = operation(regs[ip->dst], regs[ip->src], &regs[ip->dst]); \
+        if (err != MATH_ERR_OK) { \
+            return err; \
+        } \
+        VM_NEXT(); \
+    VM_CASE(name##_IMM) \
+        err = operation(regs[ip->dst], ip->imm, &regs[ip->dst]); \
+        if (err != MATH_ERR_OK) { \
+            return err; \
+        } \
+        VM_NEXT();
+
+MathErr
+regcode_run(const RegCode *code, uint64_t *result) {
+    if (code->size == 0) {
+        return MATH_ERR_MALFORMED_EXPR;
+    } else if (code->registers > EXPR_VM_STACK_DEPTH) {
+        return MATH_ERR_STACK_OVERFLOW;
+    }
+
+    uint64_t regs[EXPR_VM_STACK_DEPTH];
+    const RegInstr *ip = code->code;
+    MathErr err;
+
+#ifdef VM_THREADED
+    static const void *const dispatch[ROP_COUNT] = {
+        [ROP_HALT] = &&do_HALT,
+        [ROP_LOAD] = &&do_LOAD,
+        [ROP_NOT] = &&do_NOT,
+        [ROP_NEG] = &&do_NEG,
+        [ROP_MUL] = &&do_MUL,
+        [ROP_DIV] = &&do_DIV,
+        [ROP_MOD] = &&do_MOD,
+        [ROP_ADD] = &&do_ADD,
+        [ROP_SUB] = &&do_SUB,
+        [ROP_SHL] = &&do_SHL,
+        [ROP_SHR] = &&do_SHR,
+        [ROP_AND] = &&do_AND,
+        [ROP_XOR] = &&do_XOR,
+        [ROP_OR] = &&do_OR,
+        [ROP_MUL_IMM] = &&do_MUL_IMM,
+        [ROP_DIV_IMM] = &&do_DIV_IMM,
+        [ROP_MOD_IMM] = &&do_MOD_IMM,
+        [ROP_ADD_IMM] = &&do_ADD_IMM,
+        [ROP_SUB_IMM] = &&do_SUB_IMM,
+        [ROP_SHL_IMM] = &&do_SHL_IMM,
+        [ROP_SHR_IMM] = &&do_SHR_IMM,
+        [ROP_AND_IMM] = &&do_AND_IMM,
+        [ROP_XOR_IMM] = &&do_XOR_IMM,
+        [ROP_OR_IMM] = &&do_OR_IMM,
+        [ROP_DIV_MAGIC] = &&do_DIV_MAGIC,
+        [ROP_MOD_MAGIC] = &&do_MOD_MAGIC,
+    };
+    goto *dispatch[ip->opcode];
+#else
+    while (true) {
+        switch (ip->opcode) {
+#endif
+
+    VM_CASE(HALT)
+        *result = regs[0];
+        return MATH_ERR_OK;
+
+    VM_CASE(LOAD)
+        regs[ip->dst] = ip->imm;
+        VM_NEXT();
+
+    VM_CASE(NOT)
+        err = operation_bitwise_not(0, regs[ip->dst], &regs[ip->dst]);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+        VM_NEXT();
+
+    VM_CASE(NEG)
+        err = operation_negate(0, regs[ip->dst], &regs[ip->dst]);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+        VM_NEXT();
+
+    VM_BINARY(MUL, operation_multiply)
+    VM_BINARY(DIV, operation_divide)
+    VM_BINARY(MOD, operation_modulo)
+    VM_BINARY(ADD, operation_add)
+    VM_BINARY(SUB, operation_subtract)
+    VM_BINARY(SHL, operation_shift_left)
+    VM_BINARY(SHR, operation_shift_right)
+    VM_BINARY(AND, operation_bitwise_and)
+    VM_BINARY(XOR, operation_bitwise_xor)
+    VM_BINARY(OR, operation_bitwise_or)
+
+    VM_CASE(DIV_MAGIC) {
+        uint64_t n = regs[ip->dst];
+        uint64_t t = mul_high(ip->imm, n);
+        regs[ip->dst] = (t + ((n - t) >> 1)) >> ip->src;
+        VM_NEXT();
+    }
+
+    VM_CASE(MOD_MAGIC) {
+        uint64_t n = regs[ip->dst];
+        uint64_t t = mul_high(ip->imm, n);
+        uint64_t quotient = (t + ((n - t) >> 1)) >> ip->src;
+        ip++;
+        regs[ip->dst] = n - quotient * ip->imm;
+        VM_NEXT();
+    }
+
+#ifndef VM_THREADED
+            default: return MATH_ERR_MALFORMED_EXPR;
+        }
+    }
+#endif
+}
@@ -0,0 +1,91 @@
+#ifndef _REGCODE_H
+#define _REGCODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "error.h"
+#include "expression.h"
+
+// A compiled expression for a register machine, the faster alternative to the
+// stack machine in bytecode.h. Every instruction names its registers, so
+// operands are never pushed or popped, and an operator whose right operand is
+// a literal is fused with it into a single immediate instruction, IE "n % 16"
+// runs as a load followed by MOD_IMM. Instructions are fixed size, so they
+// decode with plain loads, at the cost of more memory than bytecode.
+//
+// Dividing by a literal never divides at run time: powers of two become
+// shifts and masks, and every other divisor becomes a multiply by its
+// precomputed reciprocal.
+typedef enum RegOpcode {
+    ROP_HALT,
+    ROP_LOAD,
+    ROP_NOT,
+    ROP_NEG,
+
+    ROP_MUL,
+    ROP_DIV,
+    ROP_MOD,
+    ROP_ADD,
+    ROP_SUB,
+    ROP_SHL,
+    ROP_SHR,
+    ROP_AND,
+    ROP_XOR,
+    ROP_OR,
+
+    ROP_MUL_IMM,
+    ROP_DIV_IMM,
+    ROP_MOD_IMM,
+    ROP_ADD_IMM,
+    ROP_SUB_IMM,
+    ROP_SHL_IMM,
+    ROP_SHR_IMM,
+    ROP_AND_IMM,
+    ROP_XOR_IMM,
+    ROP_OR_IMM,
+
+    // Division by a literal, as a multiply by its reciprocal. imm holds the
+    // magic multiplier and src the final shift. MOD_MAGIC is followed by a
+    // second instruction holding the divisor in its imm.
+    ROP_DIV_MAGIC,
+    ROP_MOD_MAGIC,
+
+    ROP_COUNT
+} RegOpcode;
+
+// dst = dst op src, or dst = dst op imm for the immediate forms.
+typedef struct RegInstr {
+    uint64_t imm;
+    uint8_t opcode;
+    uint8_t dst;
+    uint8_t src;
+} RegInstr;
+
+// Instructions needed to be sure an expression of the given number of tokens
+// will compile.
+#define REGCODE_SIZE(tokens) ((tokens) + 1)
+
+typedef struct RegCode {
+    RegInstr *code;
+    size_t size;
+    size_t capacity;
+
+    // Registers used by the code.
+    size_t registers;
+} RegCode;
+
+// Binds a program to capacity instructions of caller memory.
+void regcode_init(RegCode *code, RegInstr *buff, size_t capacity);
+
+// Compiles an expression, replacing whatever code held before. Fails with
+// MATH_ERR_OUT_OF_CODE if the program does not fit, or MATH_ERR_STACK_OVERFLOW
+// if it would need more than EXPR_VM_STACK_DEPTH registers.
+MathErr expression_compile_regcode(Expression *expr, RegCode *code);
+
+// Runs a compiled program. Gives the same result as evaluating the expression
+// it was compiled from.
+MathErr regcode_run(const RegCode *code, uint64_t *result);
+
+#endif // _REGCODE_H
@@ -0,0 +1,333 @@
+#include "shunt.h"
+#include "operator.h"
+
+#if EXPR_SHUNT_DEPTH > 255
+#error "Stack heights are counted in a byte, so EXPR_SHUNT_DEPTH can be at most 255."
+#endif
+
+// Flags describing a group.
+#define SHUNT_EXPECT_OPERATOR 0x01 // The last thing seen was a complete operand.
+#define SHUNT_BROKEN 0x02 // The group is badly formed.
+#define SHUNT_EMPTY 0x04 // Nothing but empty groups has been seen yet.
+#define SHUNT_NEGATE 0x08 // The pending unary operators negate the operand.
+#define SHUNT_AFTER_OPERAND 0x10 // The group follows an operand, so must stay empty.
+
+#define SHUNT_NEW_GROUP SHUNT_EMPTY
+
+void
+shunt_init(Shunt *shunt) {
+    shunt->value_count = 0;
+    shunt->op_count = 0;
+    shunt->frame_count = 0;
+    shunt->flags = SHUNT_NEW_GROUP;
+    shunt->add = 0;
+    shunt->deferred = MATH_ERR_OK;
+    shunt->failed = MATH_ERR_OK;
+}
+
+static MathErr
+fail(Shunt *shunt, MathErr err) {
+    shunt->failed = err;
+    return err;
+}
+
+// Folds a unary operator into the pending ones. It applies before them, since
+// they were written further left. '~' is -x - 1, so every unary operator is
+// either x -> x or x -> -x + d.
+static void
+compose_unary(Shunt *shunt, TokenType type) {
+    if (type == TOK_PLUS) {
+        return;
+    }
+
+    if (type == TOK_BITWISE_NOT) {
+        shunt->add += (shunt->flags & SHUNT_NEGATE) ? 1 : UINT64_MAX;
+    }
+    shunt->flags ^= SHUNT_NEGATE;
+}
+
+// Applies the pending unary operators to the value on top of the stack.
+static void
+apply_unary(Shunt *shunt) {
+    uint64_t *top = &shunt->values[shunt->value_count - 1];
+    *top = ((shunt->flags & SHUNT_NEGATE) ? 0 - *top : *top) + shunt->add;
+    shunt->flags &= (uint8_t)~SHUNT_NEGATE;
+    shunt->add = 0;
+}
+
+static MathErr
+push_value(Shunt *shunt, uint64_t value) {
+    if (shunt->value_count == EXPR_SHUNT_DEPTH) {
+        return fail(shunt, MATH_ERR_STACK_OVERFLOW);
+    }
+
+    shunt->values[shunt->value_count++] = value;
+    return MATH_ERR_OK;
+}
+
+// Applies the operator on top of the stack to the top two values.
+static void
+reduce(Shunt *shunt) {
+    TokenType type = (TokenType)shunt->ops[--shunt->op_count];
+    uint64_t rhs = shunt->values[--shunt->value_count];
+    uint64_t *lhs = &shunt->values[shunt->value_count - 1];
+
+    MathErr err = operator_binary(type)(*lhs, rhs, lhs);
+    if (err != MATH_ERR_OK && shunt->deferred == MATH_ERR_OK) {
+        shunt->deferred = err;
+    }
+}
+
+// Applies every operator of the innermost group, leaving its value on top of
+// the stack.
+static void
+reduce_group(Shunt *shunt) {
+    uint8_t base = shunt->frame_count == 0 ? 0 : shunt->frames[shunt->frame_count - 1].ops;
+    while (shunt->op_count > base) {
+        reduce(shunt);
+    }
+}
+
+static MathErr
+open_group(Shunt *shunt) {
+    if (shunt->frame_count == EXPR_SHUNT_DEPTH) {
+        return fail(shunt, MATH_ERR_STACK_OVERFLOW);
+    }
+
+    ShuntFrame *frame = &shunt->frames[shunt->frame_count++];
+    frame->add = shunt->add;
+    frame->ops = shunt->op_count;
+    frame->flags = shunt->flags;
+
+    // Only recorded for shunt_extend, which has to know a group can never hold
+    // anything without waiting for it to close.
+    bool after_operand = (shunt->flags & (SHUNT_EXPECT_OPERATOR | SHUNT_AFTER_OPERAND)) != 0;
+    shunt->flags = after_operand ? SHUNT_NEW_GROUP | SHUNT_AFTER_OPERAND : SHUNT_NEW_GROUP;
+    shunt->add = 0;
+    return MATH_ERR_OK;
+}
+
+static MathErr
+close_group(Shunt *shunt) {
+    if (shunt->frame_count == 0) {
+        return fail(shunt, MATH_ERR_PARENTHESIS_MISMATCH);
+    }
+
+    uint8_t flags = shunt->flags;
+    if ((flags & SHUNT_BROKEN) || (flags & (SHUNT_EXPECT_OPERATOR | SHUNT_EMPTY)) == 0) {
+        return fail(shunt, MATH_ERR_MALFORMED_EXPR);
+    }
+
+    if (flags & SHUNT_EXPECT_OPERATOR) {
+        reduce_group(shunt);
+    }
+
+    ShuntFrame *frame = &shunt->frames[--shunt->frame_count];
+    shunt->add = frame->add;
+    shunt->flags = frame->flags;
+
+    // An empty group is skipped over as if it was never there.
+    if ((flags & SHUNT_EXPECT_OPERATOR) == 0) {
+        return MATH_ERR_OK;
+    }
+
+    // The value of the group is only an operand if one was expected. Two
+    // operands in a row, IE "(1)(2)", break the enclosing group.
+    if (shunt->flags & (SHUNT_EXPECT_OPERATOR | SHUNT_BROKEN)) {
+        shunt->value_count -= 1;
+        shunt->flags |= SHUNT_BROKEN;
+        return MATH_ERR_OK;
+    }
+
+    apply_unary(shunt);
+    shunt->flags = (uint8_t)((shunt->flags | SHUNT_EXPECT_OPERATOR) & ~SHUNT_EMPTY);
+    return MATH_ERR_OK;
+}
+
+static MathErr
+push_operand_token(Shunt *shunt, TokenType type, uint64_t value) {
+    if (type == TOK_INTEGER) {
+        MathErr err = push_value(shunt, value);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+        apply_unary(shunt);
+        shunt->flags = (uint8_t)((shunt->flags | SHUNT_EXPECT_OPERATOR) & ~SHUNT_EMPTY);
+    } else if (operator_arity(type) & OP_TYPE_UNARY) {
+        compose_unary(shunt, type);
+        shunt->flags &= (uint8_t)~SHUNT_EMPTY;
+    } else {
+        shunt->flags |= SHUNT_BROKEN;
+    }
+    return MATH_ERR_OK;
+}
+
+static MathErr
+push_operator_token(Shunt *shunt, TokenType type) {
+    uint8_t prec = operator_precedence(type);
+    if (prec == 0) {
+        // Two operands in a row, IE "1 2" or "1 ~2".
+        shunt->flags |= SHUNT_BROKEN;
+        return MATH_ERR_OK;
+    }
+
+    // Operators waiting on the stack which bind at least as tightly, or only
+    // more tightly for a right associative operator, take the operand before
+    // this one.
+    bool left = operator_assoc(type) == OP_ASSOC_LEFT;
+    uint8_t base = shunt->frame_count == 0 ? 0 : shunt->frames[shunt->frame_count - 1].ops;
+    while (shunt->op_count > base) {
+        uint8_t top = operator_precedence((TokenType)shunt->ops[shunt->op_count - 1]);
+        if (top < prec || (top == prec && ! left)) {
+            break;
+        }
+        reduce(shunt);
+    }
+
+    if (shunt->op_count == EXPR_SHUNT_DEPTH) {
+        return fail(shunt, MATH_ERR_STACK_OVERFLOW);
+    }
+    shunt->ops[shunt->op_count++] = (uint8_t)type;
+    shunt->flags &= (uint8_t)~SHUNT_EXPECT_OPERATOR;
+    return MATH_ERR_OK;
+}
+
+MathErr
+shunt_push(Shunt *shunt, TokenType type, uint64_t value) {
+    if (shunt->failed != MATH_ERR_OK) {
+        return shunt->failed;
+    }
+
+    if (type == TOK_LEFT_PARENTHESIS) {
+        return open_group(shunt);
+    } else if (type == TOK_RIGHT_PARENTHESIS) {
+        return close_group(shunt);
+    } else if (shunt->flags & SHUNT_BROKEN) {
+        // Only parenthesis matter in a broken group.
+        return MATH_ERR_OK;
+    } else if (shunt->flags & SHUNT_EXPECT_OPERATOR) {
+        return push_operator_token(shunt, type);
+    }
+    return push_operand_token(shunt, type, value);
+}
+
+// Whether the token can follow the ones fed so far in a well formed expression.
+static bool
+shunt_continues(const Shunt *shunt, TokenType type) {
+    uint8_t flags = shunt->flags;
+    if (type == TOK_LEFT_PARENTHESIS) {
+        return true;
+    } else if (type == TOK_RIGHT_PARENTHESIS) {
+        // Only a group which is empty or ends on an operand can close.
+        return shunt->frame_count != 0 && (flags & (SHUNT_EXPECT_OPERATOR | SHUNT_EMPTY)) != 0;
+    } else if (flags & SHUNT_EXPECT_OPERATOR) {
+        return operator_precedence(type) != 0;
+    } else if (flags & SHUNT_AFTER_OPERAND) {
+        return false;
+    }
+    return type == TOK_INTEGER || (operator_arity(type) & OP_TYPE_UNARY) != 0;
+}
+
+bool
+shunt_extend(Shunt *shunt, TokenType type, uint64_t value) {
+    if (shunt->failed != MATH_ERR_OK || ! shunt_continues(shunt, type)) {
+        return false;
+    }
+
+    shunt_push(shunt, type, value);
+    return true;
+}
+
+// Walks the stacks from the top without popping them, in the same order
+// shunt_finish would reduce them, so only the value being built up is kept.
+MathErr
+shunt_finish_prefix(const Shunt *shunt, const uint64_t *operand, uint64_t *result) {
+    if (shunt->failed != MATH_ERR_OK) {
+        return shunt->failed;
+    }
+
+    uint8_t flags = shunt->flags;
+    uint8_t op_count = shunt->op_count;
+    uint8_t frame_count = shunt->frame_count;
+    uint8_t below;
+    uint64_t value;
+
+    if (operand != NULL && shunt_continues(shunt, TOK_INTEGER)) {
+        if (shunt->value_count == EXPR_SHUNT_DEPTH) {
+            return MATH_ERR_STACK_OVERFLOW;
+        }
+        value = ((flags & SHUNT_NEGATE) ? 0 - *operand : *operand) + shunt->add;
+        below = shunt->value_count;
+    } else {
+        // Drop whatever is still waiting for an operand: the pending unary
+        // operators, then either the binary operator before them, or the group
+        // they are the start of. A group that follows an operand goes the same
+        // way, since it is empty.
+        while ((flags & SHUNT_EXPECT_OPERATOR) == 0) {
+            uint8_t base = frame_count == 0 ? 0 : shunt->frames[frame_count - 1].ops;
+            if (op_count > base) {
+                op_count -= 1;
+                flags |= SHUNT_EXPECT_OPERATOR;
+            } else if (frame_count != 0) {
+                flags = shunt->frames[--frame_count].flags;
+            } else {
+                return MATH_ERR_MALFORMED_EXPR;
+            }
+        }
+        below = (uint8_t)(shunt->value_count - 1);
+        value = shunt->values[below];
+    }
+
+    if (flags & SHUNT_BROKEN) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+
+    // Reduce each group, then close it by applying the unary operators which
+    // were waiting for it, until the outermost group is done.
+    MathErr deferred = shunt->deferred;
+    while (true) {
+        uint8_t base = frame_count == 0 ? 0 : shunt->frames[frame_count - 1].ops;
+        while (op_count > base) {
+            TokenType type = (TokenType)shunt->ops[--op_count];
+            MathErr err = operator_binary(type)(shunt->values[--below], value, &value);
+            if (err != MATH_ERR_OK && deferred == MATH_ERR_OK) {
+                deferred = err;
+            }
+        }
+        if (frame_count == 0) {
+            break;
+        }
+
+        const ShuntFrame *frame = &shunt->frames[--frame_count];
+        if (frame->flags & (SHUNT_EXPECT_OPERATOR | SHUNT_BROKEN)) {
+            return MATH_ERR_MALFORMED_EXPR;
+        }
+        value = ((frame->flags & SHUNT_NEGATE) ? 0 - value : value) + frame->add;
+    }
+
+    if (deferred != MATH_ERR_OK) {
+        return deferred;
+    }
+    *result = value;
+    return MATH_ERR_OK;
+}
+
+MathErr
+shunt_finish(Shunt *shunt, uint64_t *result) {
+    if (shunt->failed != MATH_ERR_OK) {
+        return shunt->failed;
+    } else if (shunt->frame_count != 0) {
+        return fail(shunt, MATH_ERR_PARENTHESIS_MISMATCH);
+    } else if ((shunt->flags & (SHUNT_BROKEN | SHUNT_EXPECT_OPERATOR)) != SHUNT_EXPECT_OPERATOR) {
+        // Badly formed, empty, or ending on an operator.
+        return fail(shunt, MATH_ERR_MALFORMED_EXPR);
+    }
+
+    reduce_group(shunt);
+    if (shunt->deferred != MATH_ERR_OK) {
+        return fail(shunt, shunt->deferred);
+    }
+
+    *result = shunt->values[0];
+    return MATH_ERR_OK;
+}
@@ -0,0 +1,76 @@
+#ifndef _SHUNT_H
+#define _SHUNT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "error.h"
+#include "token.h"
+
+// Evaluates a stream of tokens in one left to right pass, with the shunting
+// yard algorithm. Operators wait on a stack until one that binds less tightly
+// arrives, and are then applied to the values waiting on a second stack, so no
+// tree is ever built and memory only grows with how deeply the expression
+// nests, never with how long it is.
+//
+// Runs of unary operators fold into a single pending x -> +-x + c, rather
+// than each taking a place on the stack.
+//
+// Results and errors are exactly those of the tree evaluator. Where the tree
+// evaluator would stop at a badly formed group or parenthesis only once that
+// group closes, a syntax error only marks its group as broken, and the rest of
+// the group is skipped over to find out which error to report. Errors from the
+// operations themselves are held back until the whole expression is known to
+// be well formed.
+
+// State saved when a parenthesis opens, and restored when it closes.
+typedef struct ShuntFrame {
+    uint64_t add;
+    uint8_t ops;
+    uint8_t flags;
+} ShuntFrame;
+
+typedef struct Shunt {
+    uint64_t values[EXPR_SHUNT_DEPTH];
+    uint8_t ops[EXPR_SHUNT_DEPTH];
+    ShuntFrame frames[EXPR_SHUNT_DEPTH];
+    uint8_t value_count;
+    uint8_t op_count;
+    uint8_t frame_count;
+
+    // State of the innermost open group: the SHUNT_* flags, and the unary
+    // operators waiting for its next operand.
+    uint8_t flags;
+    uint64_t add;
+
+    // The first error found by an operation, reported once the expression ends.
+    MathErr deferred;
+
+    // Set once the result is decided to be an error.
+    MathErr failed;
+} Shunt;
+
+void shunt_init(Shunt *shunt);
+
+// Feeds the next token. value is only used for TOK_INTEGER. Returns an error as
+// soon as the expression is certain to fail with it, after which every further
+// token fails the same way.
+MathErr shunt_push(Shunt *shunt, TokenType type, uint64_t value);
+
+// Ends the expression and hands back its value.
+MathErr shunt_finish(Shunt *shunt, uint64_t *result);
+
+// Feeds the next token only if the tokens so far are still the start of a well
+// formed expression with it. Returns false, leaving the shunt untouched, if it
+// would break the expression, or once the shunt has failed.
+bool shunt_extend(Shunt *shunt, TokenType type, uint64_t value);
+
+// Works out the value of an expression fed through shunt_extend wherever it has
+// got to, closing any open parenthesis and dropping trailing operators which
+// are still waiting for an operand. If operand is not NULL, it is a literal
+// taken to follow the tokens fed, unless it can not continue them. The shunt is
+// left untouched, so it can be fed further and finished again.
+MathErr shunt_finish_prefix(const Shunt *shunt, const uint64_t *operand, uint64_t *result);
+
+#endif // _SHUNT_H
@@ -0,0 +1,79 @@
+#include "sink.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void
+sink_init(Sink *sink, char *buff, size_t capacity, SinkWrite write, void *context) {
+    sink->buff = buff;
+    sink->size = 0;
+    sink->capacity = write == NULL ? capacity - 1 : capacity;
+    sink->write = write;
+    sink->context = context;
+    sink->failed = false;
+}
+
+static bool
+drain(Sink *sink) {
+    if (sink->write == NULL || ! sink->write(sink->context, sink->buff, sink->size)) {
+        sink->failed = true;
+        return false;
+    }
+
+    sink->size = 0;
+    return true;
+}
+
+bool
+sink_write(Sink *sink, const char *data, size_t len) {
+    while (! sink->failed && len > 0) {
+        if (sink->size == sink->capacity && ! drain(sink)) {
+            break;
+        }
+
+        size_t room = sink->capacity - sink->size;
+        size_t chunk = len < room ? len : room;
+        memcpy(sink->buff + sink->size, data, chunk);
+        sink->size += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return ! sink->failed;
+}
+
+bool
+sink_write_str(Sink *sink, const char *str) {
+    return sink_write(sink, str, strlen(str));
+}
+
+bool
+sink_write_uint(Sink *sink, uint64_t value, const FormatSpec *spec) {
+    // Formatted straight into the buffer when there is room for it and the
+    // null terminator, which is then overwritten by whatever comes next.
+    if (! sink->failed) {
+        size_t len = format_uint(value, spec, sink->buff + sink->size, sink->capacity - sink->size);
+        if (len != 0) {
+            sink->size += len;
+            return true;
+        }
+    }
+
+    char buff[FORMAT_BUFF_SIZE];
+    size_t len = format_uint(value, spec, buff, sizeof(buff));
+    return sink_write(sink, buff, len);
+}
+
+bool
+sink_flush(Sink *sink) {
+    if (sink->write == NULL) {
+        sink->buff[sink->size] = '\0';
+    } else if (! sink->failed && sink->size > 0) {
+        drain(sink);
+    }
+    return ! sink->failed;
+}
+
+bool
+sink_write_stream(void *stream, const char *data, size_t len) {
+    return fwrite(data, 1, len, (FILE *)stream) == len;
+}
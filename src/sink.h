@@ -0,0 +1,56 @@
+#ifndef _SINK_H
+#define _SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "format.h"
+
+// Hands the bytes collected by a sink on to where they are going, IE a UART's
+// transmit ring on AVR, or a file on the host. Returns false if they could not
+// all be taken.
+typedef bool (*SinkWrite)(void *context, const char *data, size_t len);
+
+// Collects output in a caller provided buffer, so that it leaves in a few large
+// writes rather than many tiny ones.
+//
+// A sink without a write callback only ever fills its buffer, and is the way to
+// serialize into memory. It keeps the last byte of the buffer for the null
+// terminator.
+//
+// Once a write fails the sink stays failed, and ignores anything written after,
+// so a whole run of writes can be checked once at the end.
+typedef struct Sink {
+    char *buff;
+    size_t size;
+    size_t capacity;
+    SinkWrite write;
+    void *context;
+    bool failed;
+} Sink;
+
+// The buffer must hold at least one byte.
+void sink_init(Sink *sink, char *buff, size_t capacity, SinkWrite write, void *context);
+
+bool sink_write(Sink *sink, const char *data, size_t len);
+bool sink_write_str(Sink *sink, const char *str);
+bool sink_write_uint(Sink *sink, uint64_t value, const FormatSpec *spec);
+
+static inline bool
+sink_put(Sink *sink, char c) {
+    if (sink->size == sink->capacity) {
+        return sink_write(sink, &c, 1);
+    }
+    sink->buff[sink->size++] = c;
+    return ! sink->failed;
+}
+
+// Writes out everything buffered so far. A memory sink is null terminated
+// instead, and fails if its output had to be cut short.
+bool sink_flush(Sink *sink);
+
+// Write callback for a stdio stream, which is passed as the context.
+bool sink_write_stream(void *stream, const char *data, size_t len);
+
+#endif // _SINK_H
@@ -0,0 +1,34 @@
+#include "stream.h"
+
+void
+stream_init(ExprStream *stream) {
+    token_lexer_init(&stream->lexer);
+    shunt_init(&stream->shunt);
+}
+
+// Errors from the evaluator are kept in the shunt rather than stopping the
+// lexer, since a bad token later in the text would still take precedence.
+static MathErr
+reduce_token(void *context, TokenType type, uint64_t value) {
+    shunt_push((Shunt *)context, type, value);
+    return MATH_ERR_OK;
+}
+
+MathErr
+stream_feed(ExprStream *stream, const char *buff, size_t len) {
+    return token_lexer_feed(&stream->lexer, buff, len, reduce_token, &stream->shunt);
+}
+
+MathErr
+stream_feed_char(ExprStream *stream, char c) {
+    return token_lexer_feed(&stream->lexer, &c, 1, reduce_token, &stream->shunt);
+}
+
+MathErr
+stream_finish(ExprStream *stream, uint64_t *result) {
+    MathErr err = token_lexer_finish(&stream->lexer, reduce_token, &stream->shunt);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+    return shunt_finish(&stream->shunt, result);
+}
@@ -0,0 +1,36 @@
+#ifndef _STREAM_H
+#define _STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "shunt.h"
+#include "token.h"
+
+// Evaluates an expression as its text arrives, a byte or a chunk at a time,
+// IE straight from a pipe or a UART. Each token is reduced as soon as it is
+// lexed, so the token list never exists, and an expression of any length can
+// be evaluated in the fixed memory of an ExprStream. Only nesting deeper than
+// EXPR_SHUNT_DEPTH fails, with MATH_ERR_STACK_OVERFLOW.
+//
+// The result is the same as parsing the whole text with expression_set_from_str
+// and evaluating it, errors included. Since an invalid token anywhere in the
+// text takes precedence over every other error, only lexing errors can be
+// reported before the text ends.
+typedef struct ExprStream {
+    TokLexer lexer;
+    Shunt shunt;
+} ExprStream;
+
+void stream_init(ExprStream *stream);
+
+// Feeds the next len bytes of text. Once an error is returned the stream is
+// done, and must be initialized again before reuse.
+MathErr stream_feed(ExprStream *stream, const char *buff, size_t len);
+MathErr stream_feed_char(ExprStream *stream, char c);
+
+// Ends the text and hands back the value of the expression.
+MathErr stream_finish(ExprStream *stream, uint64_t *result);
+
+#endif // _STREAM_H
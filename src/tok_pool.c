@@ -0,0 +1,389 @@
+#include "tok_pool.h"
+
+#include <stdlib.h>
+
+static uintptr_t
+align_up(uintptr_t addr, size_t align) {
+    return (addr + align - 1) & ~(uintptr_t)(align - 1);
+}
+
+#ifdef EXPR_COMPACT_TOKENS
+
+// Largest number of tokens a TokRef can address, with TOK_NIL left over.
+#define TOK_MAX_CAPACITY ((size_t)TOK_NIL)
+
+// Lays out the arrays of a pool for capacity tokens starting at base, widest
+// elements first so each array stays aligned. Returns the end of the layout.
+static uintptr_t
+layout_arrays(TokPool *pool, uintptr_t base, size_t capacity) {
+    uintptr_t addr = align_up(base, sizeof(PackedValue));
+    pool->values = (PackedValue *)addr;
+    addr += capacity * sizeof(PackedValue);
+
+    addr = align_up(addr, sizeof(TokRef));
+    pool->pre = (TokRef *)addr;
+    pool->next = pool->pre + capacity;
+    pool->left = pool->next + capacity;
+    pool->right = pool->left + capacity;
+    pool->parent = pool->right + capacity;
+    addr = (uintptr_t)(pool->parent + capacity);
+
+    pool->types = (uint8_t *)addr;
+    return addr + capacity;
+}
+
+void
+tok_pool_init_arena(TokPool *pool, void *arena, size_t arena_size) {
+    uintptr_t base = (uintptr_t)arena;
+    uintptr_t limit = base + arena_size;
+
+    // Start from an estimate, then back off until the aligned layout fits.
+    size_t capacity = arena_size / TOK_BYTES_PER_TOKEN;
+    if (capacity > TOK_MAX_CAPACITY) {
+        capacity = TOK_MAX_CAPACITY;
+    }
+    while (capacity > 0 && layout_arrays(pool, base, capacity) > limit) {
+        capacity -= 1;
+    }
+    layout_arrays(pool, base, capacity);
+
+    pool->used = 0;
+    pool->capacity = capacity;
+    pool->chunk_tokens = 0;
+    pool->free_list = TOK_NIL;
+    pool->in_order = true;
+}
+
+#ifndef __AVR__
+void
+tok_pool_init_growable(TokPool *pool, size_t chunk_tokens) {
+    memset(pool, 0, sizeof(TokPool));
+    pool->chunk_tokens = chunk_tokens;
+    pool->free_list = TOK_NIL;
+    pool->in_order = true;
+}
+
+void
+tok_pool_free(TokPool *pool) {
+    if (pool->chunk_tokens != 0) {
+        free(pool->types);
+        free(pool->values);
+        free(pool->pre);
+        free(pool->next);
+        free(pool->left);
+        free(pool->right);
+        free(pool->parent);
+    }
+    tok_pool_init_growable(pool, 0);
+}
+
+// Tokens are addressed by index, so growing the arrays in place keeps every
+// link valid.
+static bool
+grow_array(void **array, size_t elem_size, size_t capacity) {
+    void *grown = realloc(*array, elem_size * capacity);
+    if (grown == NULL) {
+        return false;
+    }
+    *array = grown;
+    return true;
+}
+#endif
+
+bool
+tok_pool_grow(TokPool *pool) {
+#ifdef __AVR__
+    (void)pool;
+    return false;
+#else
+    if (pool->chunk_tokens == 0 || pool->capacity == TOK_MAX_CAPACITY) {
+        return false;
+    }
+
+    size_t capacity = pool->capacity + pool->chunk_tokens;
+    if (capacity > TOK_MAX_CAPACITY) {
+        capacity = TOK_MAX_CAPACITY;
+    }
+
+    // A failed step leaves some arrays longer than others, which is harmless
+    // since the capacity only moves once they have all grown.
+    if (! grow_array((void **)&pool->types, sizeof(uint8_t), capacity)
+        || ! grow_array((void **)&pool->values, sizeof(PackedValue), capacity)
+        || ! grow_array((void **)&pool->pre, sizeof(TokRef), capacity)
+        || ! grow_array((void **)&pool->next, sizeof(TokRef), capacity)
+        || ! grow_array((void **)&pool->left, sizeof(TokRef), capacity)
+        || ! grow_array((void **)&pool->right, sizeof(TokRef), capacity)
+        || ! grow_array((void **)&pool->parent, sizeof(TokRef), capacity)) {
+        return false;
+    }
+
+    pool->capacity = capacity;
+    return true;
+#endif
+}
+
+void
+tok_pool_clear(TokPool *pool) {
+    pool->used = 0;
+    pool->free_list = TOK_NIL;
+    pool->in_order = true;
+}
+
+// Slots are numbered in allocation order.
+typedef struct SlotIter {
+    size_t index;
+} SlotIter;
+
+static TokRef
+slot_begin(const TokPool *pool, SlotIter *iter) {
+    iter->index = 0;
+    return pool->used > 0 ? 0 : TOK_NIL;
+}
+
+static TokRef
+slot_next(const TokPool *pool, SlotIter *iter) {
+    iter->index += 1;
+    return iter->index < pool->used ? (TokRef)iter->index : TOK_NIL;
+}
+
+// Truncates the pool just after the slot the iterator is on.
+static void
+slot_truncate(TokPool *pool, const SlotIter *iter) {
+    pool->used = iter->index + 1;
+    pool->in_order = true;
+}
+
+static void
+tok_swap(TokPool *pool, TokRef a, TokRef b) {
+    uint8_t type = pool->types[a];
+    pool->types[a] = pool->types[b];
+    pool->types[b] = type;
+
+    PackedValue value = pool->values[a];
+    pool->values[a] = pool->values[b];
+    pool->values[b] = value;
+
+    TokRef *links[] = { pool->pre, pool->next, pool->left, pool->right, pool->parent };
+    for (size_t i = 0; i < sizeof(links) / sizeof(links[0]); i++) {
+        TokRef link = links[i][a];
+        links[i][a] = links[i][b];
+        links[i][b] = link;
+    }
+}
+
+#else
+
+void
+tok_pool_init_arena(TokPool *pool, void *arena, size_t arena_size) {
+    uintptr_t base = align_up((uintptr_t)arena, _Alignof(Token));
+    uintptr_t limit = (uintptr_t)arena + arena_size;
+
+    memset(pool, 0, sizeof(TokPool));
+    pool->slots = (Token *)base;
+    pool->capacity = base < limit ? (limit - base) / sizeof(Token) : 0;
+    pool->free_list = TOK_NIL;
+}
+
+#ifndef __AVR__
+void
+tok_pool_init_growable(TokPool *pool, size_t chunk_tokens) {
+    memset(pool, 0, sizeof(TokPool));
+    pool->chunk_tokens = chunk_tokens;
+    pool->free_list = TOK_NIL;
+}
+
+void
+tok_pool_free(TokPool *pool) {
+    TokChunk *chunk = pool->first_chunk;
+    while (chunk != NULL) {
+        TokChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    tok_pool_init_growable(pool, 0);
+}
+#endif
+
+// Moves allocation on to the next chunk, reusing one left over from before
+// the last reset if there is one. Tokens are linked by pointer, so earlier
+// chunks never move.
+bool
+tok_pool_grow(TokPool *pool) {
+#ifdef __AVR__
+    (void)pool;
+    return false;
+#else
+    if (pool->chunk_tokens == 0) {
+        return false;
+    }
+
+    TokChunk *chunk = pool->cur_chunk == NULL ? pool->first_chunk : pool->cur_chunk->next;
+    if (chunk == NULL) {
+        chunk = malloc(sizeof(TokChunk) + pool->chunk_tokens * sizeof(Token));
+        if (chunk == NULL) {
+            return false;
+        }
+
+        chunk->next = NULL;
+        chunk->capacity = pool->chunk_tokens;
+        if (pool->cur_chunk == NULL) {
+            pool->first_chunk = chunk;
+        } else {
+            pool->cur_chunk->next = chunk;
+        }
+    }
+
+    pool->cur_chunk = chunk;
+    pool->slots = chunk->slots;
+    pool->used = 0;
+    pool->capacity = chunk->capacity;
+    return true;
+#endif
+}
+
+void
+tok_pool_clear(TokPool *pool) {
+    pool->used = 0;
+    pool->free_list = TOK_NIL;
+    if (pool->chunk_tokens != 0) {
+        pool->cur_chunk = NULL;
+        pool->slots = NULL;
+        pool->capacity = 0;
+    }
+}
+
+// Slots are visited in allocation order: the whole arena, or every chunk up
+// to and including the current one.
+typedef struct SlotIter {
+    TokChunk *chunk;
+    Token *slots;
+    size_t count;
+    size_t index;
+} SlotIter;
+
+static void
+slot_enter(const TokPool *pool, SlotIter *iter, TokChunk *chunk) {
+    iter->chunk = chunk;
+    iter->slots = chunk->slots;
+    iter->count = chunk == pool->cur_chunk ? pool->used : chunk->capacity;
+    iter->index = 0;
+}
+
+static TokRef
+slot_begin(const TokPool *pool, SlotIter *iter) {
+    if (pool->chunk_tokens == 0) {
+        iter->chunk = NULL;
+        iter->slots = pool->slots;
+        iter->count = pool->used;
+        iter->index = 0;
+    } else if (pool->cur_chunk == NULL) {
+        return TOK_NIL;
+    } else {
+        slot_enter(pool, iter, pool->first_chunk);
+    }
+
+    return iter->count > 0 ? &iter->slots[0] : TOK_NIL;
+}
+
+static TokRef
+slot_next(const TokPool *pool, SlotIter *iter) {
+    iter->index += 1;
+    if (iter->index == iter->count) {
+        if (iter->chunk == NULL || iter->chunk == pool->cur_chunk) {
+            return TOK_NIL;
+        }
+        slot_enter(pool, iter, iter->chunk->next);
+    }
+
+    return iter->index < iter->count ? &iter->slots[iter->index] : TOK_NIL;
+}
+
+// Truncates the pool just after the slot the iterator is on.
+static void
+slot_truncate(TokPool *pool, const SlotIter *iter) {
+    if (iter->chunk != NULL) {
+        pool->cur_chunk = iter->chunk;
+        pool->slots = iter->chunk->slots;
+        pool->capacity = iter->chunk->capacity;
+    }
+    pool->used = iter->index + 1;
+}
+
+static void
+tok_swap(TokPool *pool, TokRef a, TokRef b) {
+    (void)pool;
+    Token tok = *a;
+    *a = *b;
+    *b = tok;
+}
+
+#endif
+
+void
+tok_pool_compact(TokPool *pool, TokRef *start, TokRef *end) {
+    // Give every allocated slot the slot its token should move to, kept in its
+    // left link: listed tokens take the first slots in list order, followed by
+    // released tokens, then any slot which is in neither.
+    SlotIter iter;
+    for (TokRef slot = slot_begin(pool, &iter); slot != TOK_NIL; slot = slot_next(pool, &iter)) {
+        tok_set_left(pool, slot, TOK_NIL);
+    }
+
+    SlotIter dest_iter;
+    TokRef dest = slot_begin(pool, &dest_iter);
+    size_t live = 0;
+    for (TokRef tok = *start; tok != TOK_NIL; tok = tok_next(pool, tok)) {
+        tok_set_left(pool, tok, dest);
+        dest = slot_next(pool, &dest_iter);
+        live += 1;
+    }
+    for (TokRef tok = pool->free_list; tok != TOK_NIL; tok = tok_next(pool, tok)) {
+        tok_set_left(pool, tok, dest);
+        dest = slot_next(pool, &dest_iter);
+    }
+    for (TokRef slot = slot_begin(pool, &iter); slot != TOK_NIL; slot = slot_next(pool, &iter)) {
+        if (tok_left(pool, slot) == TOK_NIL) {
+            tok_set_left(pool, slot, dest);
+            dest = slot_next(pool, &dest_iter);
+        }
+    }
+
+    // Follow each cycle of the permutation, swapping tokens into place. Every
+    // swap settles one token, so this is linear in the number of slots.
+    for (TokRef slot = slot_begin(pool, &iter); slot != TOK_NIL; slot = slot_next(pool, &iter)) {
+        while (tok_left(pool, slot) != slot) {
+            tok_swap(pool, slot, tok_left(pool, slot));
+        }
+    }
+
+    // Relink the listed tokens in slot order, and drop everything after them.
+    pool->free_list = TOK_NIL;
+    if (live == 0) {
+        tok_pool_clear(pool);
+        *start = TOK_NIL;
+        *end = TOK_NIL;
+        return;
+    }
+
+    TokRef pre = TOK_NIL;
+    TokRef slot = slot_begin(pool, &iter);
+    *start = slot;
+    for (size_t i = 0; i < live; i++) {
+        tok_set_pre(pool, slot, pre);
+        tok_set_left(pool, slot, TOK_NIL);
+        tok_set_right(pool, slot, TOK_NIL);
+        tok_set_parent(pool, slot, TOK_NIL);
+        if (pre != TOK_NIL) {
+            tok_set_next(pool, pre, slot);
+        }
+
+        pre = slot;
+        if (i + 1 < live) {
+            slot = slot_next(pool, &iter);
+        }
+    }
+
+    tok_set_next(pool, pre, TOK_NIL);
+    *end = pre;
+    slot_truncate(pool, &iter);
+}
@@ -0,0 +1,330 @@
+#ifndef _TOK_POOL_H
+#define _TOK_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "config.h"
+#include "platform.h"
+#include "token.h"
+
+// Storage for the tokens of an expression, along with the accessors used to
+// walk them. Expression code never touches the fields of a pooled token
+// directly, so the layout can be picked at build time:
+//
+//  * By default the pool holds plain Tokens, and a TokRef is a Token pointer.
+//  * With EXPR_COMPACT_TOKENS, the pool is a structure of arrays indexed by
+//    TokRef, which is EXPR_TOKEN_REF_BITS wide. The type shares a byte with 4
+//    bits of flags, and literals are stored in EXPR_VALUE_BITS bits. On AVR a
+//    token shrinks from 21 bytes to between 7 and 14 bytes. Keeping the types
+//    in their own dense array also means scans which only care about the type,
+//    such as finding parenthesis, touch a single byte per token, and can test
+//    8 tokens at a time on the host.
+//
+// Either way, TOK_NIL stands in for a missing link.
+//
+// A pool never owns fixed storage. It is either carved out of an arena
+// provided by the caller, or on the host, grown from the heap in chunks as
+// tokens are allocated. Released tokens go on a free list threaded through
+// their next links, and are reused before any fresh slot.
+//
+// While tokens are only appended, the slots of a compact pool hold the
+// expression in list order, which lets scans walk the arrays directly. Reusing
+// a slot breaks that order until the pool is compacted.
+
+#ifdef EXPR_COMPACT_TOKENS
+
+#if EXPR_VALUE_BITS == 8
+typedef uint8_t PackedValue;
+#elif EXPR_VALUE_BITS == 16
+typedef uint16_t PackedValue;
+#elif EXPR_VALUE_BITS == 32
+typedef uint32_t PackedValue;
+#elif EXPR_VALUE_BITS == 64
+typedef uint64_t PackedValue;
+#else
+#error "EXPR_VALUE_BITS must be one of 8, 16, 32 or 64."
+#endif
+
+#if EXPR_TOKEN_REF_BITS == 8
+typedef uint8_t TokRef;
+#define TOK_NIL ((TokRef)UINT8_MAX)
+#elif EXPR_TOKEN_REF_BITS == 16
+typedef uint16_t TokRef;
+#define TOK_NIL ((TokRef)UINT16_MAX)
+#elif EXPR_TOKEN_REF_BITS == 32
+typedef uint32_t TokRef;
+#define TOK_NIL ((TokRef)UINT32_MAX)
+#else
+#error "EXPR_TOKEN_REF_BITS must be one of 8, 16 or 32."
+#endif
+
+#define TOK_TYPE_MASK 0x0F
+
+// Type byte of a released slot. Its type nibble matches no real token, so
+// array scans pass over it.
+#define TOK_TYPE_FREE 0xFF
+
+// Bytes of arena used by each token.
+#define TOK_BYTES_PER_TOKEN (sizeof(PackedValue) + 5 * sizeof(TokRef) + 1)
+
+typedef struct TokPool {
+    // The TokenType lives in the low nibble, the high nibble holds its
+    // TOK_FLAG_* flags.
+    uint8_t *types;
+    PackedValue *values;
+
+    TokRef *pre;
+    TokRef *next;
+    TokRef *left;
+    TokRef *right;
+    TokRef *parent;
+
+    size_t used;
+    size_t capacity;
+
+    // Tokens to add each time the pool grows, or 0 if it can not grow.
+    size_t chunk_tokens;
+
+    TokRef free_list;
+
+    // Set while the allocated slots are in list order.
+    bool in_order;
+} TokPool;
+
+static inline bool
+tok_value_fits(uint64_t value) {
+    return value <= (PackedValue)UINT64_MAX;
+}
+
+static inline void
+tok_init(TokPool *pool, TokRef ref, TokenType type, uint64_t value) {
+    pool->types[ref] = (uint8_t)type;
+    pool->values[ref] = (PackedValue)value;
+    pool->pre[ref] = TOK_NIL;
+    pool->next[ref] = TOK_NIL;
+    pool->left[ref] = TOK_NIL;
+    pool->right[ref] = TOK_NIL;
+    pool->parent[ref] = TOK_NIL;
+}
+
+static inline TokenType
+tok_type(const TokPool *pool, TokRef ref) {
+    return (TokenType)(pool->types[ref] & TOK_TYPE_MASK);
+}
+
+static inline uint8_t
+tok_flags(const TokPool *pool, TokRef ref) {
+    return (uint8_t)(pool->types[ref] >> 4);
+}
+
+static inline void
+tok_set_flags(TokPool *pool, TokRef ref, uint8_t flags) {
+    pool->types[ref] = (uint8_t)((pool->types[ref] & TOK_TYPE_MASK) | (flags << 4));
+}
+
+static inline uint64_t
+tok_value(const TokPool *pool, TokRef ref) {
+    return pool->values[ref];
+}
+
+static inline void
+tok_set_value(TokPool *pool, TokRef ref, uint64_t value) {
+    pool->values[ref] = (PackedValue)value;
+}
+
+// Records that a token was linked in somewhere other than the end of the
+// expression, so the slots are no longer in list order.
+static inline void
+tok_pool_unorder(TokPool *pool) {
+    pool->in_order = false;
+}
+
+static inline TokRef tok_pre(const TokPool *pool, TokRef ref) { return pool->pre[ref]; }
+static inline TokRef tok_next(const TokPool *pool, TokRef ref) { return pool->next[ref]; }
+static inline TokRef tok_left(const TokPool *pool, TokRef ref) { return pool->left[ref]; }
+static inline TokRef tok_right(const TokPool *pool, TokRef ref) { return pool->right[ref]; }
+static inline TokRef tok_parent(const TokPool *pool, TokRef ref) { return pool->parent[ref]; }
+
+static inline void tok_set_pre(TokPool *pool, TokRef ref, TokRef to) { pool->pre[ref] = to; }
+static inline void tok_set_next(TokPool *pool, TokRef ref, TokRef to) { pool->next[ref] = to; }
+static inline void tok_set_left(TokPool *pool, TokRef ref, TokRef to) { pool->left[ref] = to; }
+static inline void tok_set_right(TokPool *pool, TokRef ref, TokRef to) { pool->right[ref] = to; }
+static inline void tok_set_parent(TokPool *pool, TokRef ref, TokRef to) { pool->parent[ref] = to; }
+
+// Returns the first parenthesis at or after from, or TOK_NIL if there are none
+// before the end of the expression.
+static inline TokRef
+tok_find_paren(const TokPool *pool, TokRef from) {
+    if (from == TOK_NIL) {
+        return TOK_NIL;
+    }
+
+    if (! pool->in_order) {
+        while (from != TOK_NIL && tok_type(pool, from) > TOK_RIGHT_PARENTHESIS) {
+            from = pool->next[from];
+        }
+        return from;
+    }
+
+    size_t index = from;
+#ifdef PLATFORM_SWAR
+    // Parenthesis are the only token types below 2. Subtracting 2 from every
+    // byte borrows into the top bit of the first byte which was below it.
+    for (; index + 8 <= pool->used; index += 8) {
+        uint64_t word;
+        memcpy(&word, &pool->types[index], sizeof(word));
+        word &= 0x0F0F0F0F0F0F0F0F;
+
+        uint64_t found = (word - 0x0202020202020202) & ~word & 0x8080808080808080;
+        if (found != 0) {
+            return (TokRef)(index + (__builtin_ctzll(found) >> 3));
+        }
+    }
+#endif
+    for (; index < pool->used; index += 1) {
+        if ((pool->types[index] & TOK_TYPE_MASK) <= TOK_RIGHT_PARENTHESIS) {
+            return (TokRef)index;
+        }
+    }
+
+    return TOK_NIL;
+}
+
+#else
+
+typedef Token *TokRef;
+#define TOK_NIL NULL
+
+#define TOK_BYTES_PER_TOKEN (sizeof(Token))
+
+// Heap allocated storage for a growable pool. Chunks are kept after the pool
+// is reset and reused in order.
+typedef struct TokChunk {
+    struct TokChunk *next;
+    size_t capacity;
+    Token slots[];
+} TokChunk;
+
+typedef struct TokPool {
+    // The segment tokens are currently allocated from, either the arena or the
+    // current chunk.
+    Token *slots;
+    size_t used;
+    size_t capacity;
+
+    // Tokens in each new chunk, or 0 if the pool can not grow.
+    size_t chunk_tokens;
+    TokChunk *first_chunk;
+    TokChunk *cur_chunk;
+
+    TokRef free_list;
+} TokPool;
+
+static inline bool
+tok_value_fits(uint64_t value) {
+    (void)value;
+    return true;
+}
+
+static inline void
+tok_init(TokPool *pool, TokRef ref, TokenType type, uint64_t value) {
+    (void)pool;
+    ref->pre = NULL;
+    ref->next = NULL;
+    ref->left = NULL;
+    ref->right = NULL;
+    ref->parent = NULL;
+    ref->type = type;
+    ref->flags = 0;
+    ref->value = value;
+}
+
+static inline TokenType tok_type(const TokPool *pool, TokRef ref) { (void)pool; return ref->type; }
+static inline uint8_t tok_flags(const TokPool *pool, TokRef ref) { (void)pool; return ref->flags; }
+static inline void tok_set_flags(TokPool *pool, TokRef ref, uint8_t flags) { (void)pool; ref->flags = flags; }
+static inline uint64_t tok_value(const TokPool *pool, TokRef ref) { (void)pool; return ref->value; }
+static inline void tok_set_value(TokPool *pool, TokRef ref, uint64_t value) { (void)pool; ref->value = value; }
+static inline void tok_pool_unorder(TokPool *pool) { (void)pool; }
+
+static inline TokRef tok_pre(const TokPool *pool, TokRef ref) { (void)pool; return ref->pre; }
+static inline TokRef tok_next(const TokPool *pool, TokRef ref) { (void)pool; return ref->next; }
+static inline TokRef tok_left(const TokPool *pool, TokRef ref) { (void)pool; return ref->left; }
+static inline TokRef tok_right(const TokPool *pool, TokRef ref) { (void)pool; return ref->right; }
+static inline TokRef tok_parent(const TokPool *pool, TokRef ref) { (void)pool; return ref->parent; }
+
+static inline void tok_set_pre(TokPool *pool, TokRef ref, TokRef to) { (void)pool; ref->pre = to; }
+static inline void tok_set_next(TokPool *pool, TokRef ref, TokRef to) { (void)pool; ref->next = to; }
+static inline void tok_set_left(TokPool *pool, TokRef ref, TokRef to) { (void)pool; ref->left = to; }
+static inline void tok_set_right(TokPool *pool, TokRef ref, TokRef to) { (void)pool; ref->right = to; }
+static inline void tok_set_parent(TokPool *pool, TokRef ref, TokRef to) { (void)pool; ref->parent = to; }
+
+static inline TokRef
+tok_find_paren(const TokPool *pool, TokRef from) {
+    (void)pool;
+    while (from != NULL && from->type > TOK_RIGHT_PARENTHESIS) {
+        from = from->next;
+    }
+    return from;
+}
+
+#endif
+
+// Bytes of arena needed to hold the given number of tokens, including room to
+// align the arena.
+#define TOK_ARENA_SIZE(tokens) ((tokens) * TOK_BYTES_PER_TOKEN + 16)
+
+// Binds the pool to arena_size bytes of caller memory. The pool holds as many
+// tokens as fit, up to the number a TokRef can address.
+void tok_pool_init_arena(TokPool *pool, void *arena, size_t arena_size);
+
+#ifndef __AVR__
+// Starts an empty pool which grows from the heap, chunk_tokens at a time.
+void tok_pool_init_growable(TokPool *pool, size_t chunk_tokens);
+void tok_pool_free(TokPool *pool);
+#endif
+
+bool tok_pool_grow(TokPool *pool);
+void tok_pool_clear(TokPool *pool);
+
+// Moves the tokens of the list running from *start to *end into the first
+// slots of the pool, in list order, and empties the free list. Only the pre
+// and next links survive, so any tree built over the tokens is lost.
+void tok_pool_compact(TokPool *pool, TokRef *start, TokRef *end);
+
+// Allocates a token, or returns TOK_NIL if the pool is exhausted.
+static inline TokRef
+tok_pool_alloc(TokPool *pool) {
+    TokRef reused = pool->free_list;
+    if (reused != TOK_NIL) {
+        pool->free_list = tok_next(pool, reused);
+#ifdef EXPR_COMPACT_TOKENS
+        pool->in_order = false;
+#endif
+        return reused;
+    }
+
+    if (pool->used == pool->capacity && ! tok_pool_grow(pool)) {
+        return TOK_NIL;
+    }
+
+#ifdef EXPR_COMPACT_TOKENS
+    return (TokRef)pool->used++;
+#else
+    return &pool->slots[pool->used++];
+#endif
+}
+
+// Returns a token which is no longer linked into any list to the pool.
+static inline void
+tok_pool_release(TokPool *pool, TokRef ref) {
+#ifdef EXPR_COMPACT_TOKENS
+    pool->types[ref] = TOK_TYPE_FREE;
+#endif
+    tok_set_next(pool, ref, pool->free_list);
+    pool->free_list = ref;
+}
+
+#endif // _TOK_POOL_H
@@ -1,143 +1,590 @@
 #include "token.h"
+#include "format.h"
+#include "operator.h"
+#include "platform.h"
 
-#include <inttypes.h>
-#include <stdio.h>
-#include <assert.h>
 #include <string.h>
-#include <stdlib.h>
 
 // Note: str should be large enough to hold the maximum length string possible.
 // 20 characters plus null terminator will safely represent UINT64_MAX.
 bool
 token_to_str(const Token *tok, char *buff, size_t buff_size) {
-    switch (tok->type) {
-        case TOK_LEFT_PARENTHESIS: return 0 <= snprintf(buff, buff_size, "(");
-        case TOK_RIGHT_PARENTHESIS: return 0 <= snprintf(buff, buff_size, ")");
-        case TOK_BITWISE_NOT: return 0 <= snprintf(buff, buff_size, "~");
-        case TOK_TIMES: return 0 <= snprintf(buff, buff_size, "*");
-        case TOK_DIVIDED_BY: return 0 <= snprintf(buff, buff_size, "/");
-        case TOK_MODULO: return 0 <= snprintf(buff, buff_size, "%");
-        case TOK_PLUS: return 0 <= snprintf(buff, buff_size, "+");
-        case TOK_MINUS: return 0 <= snprintf(buff, buff_size, "-");
-        case TOK_BITWISE_LEFT_SHIFT: return 0 <= snprintf(buff, buff_size, "<<");
-        case TOK_BITWISE_RIGHT_SHIFT: return 0 <= snprintf(buff, buff_size, ">>");
-        case TOK_BITWISE_AND: return 0 <= snprintf(buff, buff_size, "&");
-        case TOK_BITWISE_XOR: return 0 <= snprintf(buff, buff_size, "^");
-        case TOK_BITWISE_OR: return 0 <= snprintf(buff, buff_size, "|");
-        case TOK_INTEGER: return 0 <= snprintf(buff, buff_size, "%" PRIu64, tok->value);
+    if (tok->type == TOK_INTEGER) {
+        static const FormatSpec decimal = {FORMAT_BASE_DEC, 0, 0, false};
+        return format_uint(tok->value, &decimal, buff, buff_size) != 0;
     }
+
+    char glyph[sizeof(g_operators[0].glyph)];
+    size_t len = operator_glyph(tok->type, glyph);
+    if (len >= buff_size) {
+        return false;
+    }
+
+    memcpy(buff, glyph, len + 1);
+    return true;
+}
+
+// Every byte the lexer reads is classified with a single load from this table.
+// The high nibble of an entry holds the character class, and the low nibble a
+// class specific payload: the token type for operators, or the digit value for
+// digits and hexadecimal letters. Bytes not listed are CC_INVALID, including
+// the null terminator. Every class from CC_DIGIT on can appear inside a
+// literal.
+enum CharClass {
+    CC_INVALID = 0,
+    CC_SPACE,
+    CC_OPERATOR,
+    CC_DOUBLED, // Only an operator when repeated, IE << and >>.
+    CC_DIGIT,
+    CC_HEX_LETTER,
+    CC_PREFIX_B, // The binary prefix, which is also the hexadecimal digit B.
+    CC_PREFIX_X,
+};
+
+#define CHAR_CLASS(cls, payload) ((uint8_t)(((cls) << 4) | (payload)))
+#define CLASS_OF(entry) ((entry) >> 4)
+#define PAYLOAD_OF(entry) ((entry) & 0x0F)
+
+static const uint8_t char_class[256] PROGMEM = {
+    [' '] = CHAR_CLASS(CC_SPACE, 0),
+    ['\t'] = CHAR_CLASS(CC_SPACE, 0),
+    ['\n'] = CHAR_CLASS(CC_SPACE, 0),
+    ['\v'] = CHAR_CLASS(CC_SPACE, 0),
+    ['\f'] = CHAR_CLASS(CC_SPACE, 0),
+    ['\r'] = CHAR_CLASS(CC_SPACE, 0),
+
+    ['('] = CHAR_CLASS(CC_OPERATOR, TOK_LEFT_PARENTHESIS),
+    [')'] = CHAR_CLASS(CC_OPERATOR, TOK_RIGHT_PARENTHESIS),
+    ['~'] = CHAR_CLASS(CC_OPERATOR, TOK_BITWISE_NOT),
+    ['*'] = CHAR_CLASS(CC_OPERATOR, TOK_TIMES),
+    ['/'] = CHAR_CLASS(CC_OPERATOR, TOK_DIVIDED_BY),
+    ['%'] = CHAR_CLASS(CC_OPERATOR, TOK_MODULO),
+    ['+'] = CHAR_CLASS(CC_OPERATOR, TOK_PLUS),
+    ['-'] = CHAR_CLASS(CC_OPERATOR, TOK_MINUS),
+    ['&'] = CHAR_CLASS(CC_OPERATOR, TOK_BITWISE_AND),
+    ['^'] = CHAR_CLASS(CC_OPERATOR, TOK_BITWISE_XOR),
+    ['|'] = CHAR_CLASS(CC_OPERATOR, TOK_BITWISE_OR),
+    ['<'] = CHAR_CLASS(CC_DOUBLED, TOK_BITWISE_LEFT_SHIFT),
+    ['>'] = CHAR_CLASS(CC_DOUBLED, TOK_BITWISE_RIGHT_SHIFT),
+
+    ['0'] = CHAR_CLASS(CC_DIGIT, 0),
+    ['1'] = CHAR_CLASS(CC_DIGIT, 1),
+    ['2'] = CHAR_CLASS(CC_DIGIT, 2),
+    ['3'] = CHAR_CLASS(CC_DIGIT, 3),
+    ['4'] = CHAR_CLASS(CC_DIGIT, 4),
+    ['5'] = CHAR_CLASS(CC_DIGIT, 5),
+    ['6'] = CHAR_CLASS(CC_DIGIT, 6),
+    ['7'] = CHAR_CLASS(CC_DIGIT, 7),
+    ['8'] = CHAR_CLASS(CC_DIGIT, 8),
+    ['9'] = CHAR_CLASS(CC_DIGIT, 9),
+
+    ['a'] = CHAR_CLASS(CC_HEX_LETTER, 10),
+    ['b'] = CHAR_CLASS(CC_PREFIX_B, 11),
+    ['c'] = CHAR_CLASS(CC_HEX_LETTER, 12),
+    ['d'] = CHAR_CLASS(CC_HEX_LETTER, 13),
+    ['e'] = CHAR_CLASS(CC_HEX_LETTER, 14),
+    ['f'] = CHAR_CLASS(CC_HEX_LETTER, 15),
+    ['A'] = CHAR_CLASS(CC_HEX_LETTER, 10),
+    ['B'] = CHAR_CLASS(CC_PREFIX_B, 11),
+    ['C'] = CHAR_CLASS(CC_HEX_LETTER, 12),
+    ['D'] = CHAR_CLASS(CC_HEX_LETTER, 13),
+    ['E'] = CHAR_CLASS(CC_HEX_LETTER, 14),
+    ['F'] = CHAR_CLASS(CC_HEX_LETTER, 15),
+
+    ['x'] = CHAR_CLASS(CC_PREFIX_X, 0),
+    ['X'] = CHAR_CLASS(CC_PREFIX_X, 0),
+};
+
+static inline uint8_t
+classify(char c) {
+    return PROGMEM_READ_BYTE(&char_class[(uint8_t)c]);
+}
+
+// Byte at pos, or the null terminator once the end of the buffer is reached.
+// Lexing through this never reads past limit, and the terminator is
+// CC_INVALID, so every scan stops there.
+static inline char
+byte_at(const char *pos, const char *limit) {
+    return pos < limit ? *pos : '\0';
 }
 
 const char *
-token_set_from_str(Token *tok, const char *buff) {
-    switch (buff[0]) {
-        case '(': {
-            tok->type = TOK_LEFT_PARENTHESIS;
-            return buff + 1;
-        }
+token_skip_space(const char *buff, size_t len) {
+    const char *limit = buff + len;
+    while (CLASS_OF(classify(byte_at(buff, limit))) == CC_SPACE) {
+        buff += 1;
+    }
+    return buff;
+}
 
-        case ')': {
-            tok->type = TOK_RIGHT_PARENTHESIS;
-            return buff + 1;
-        }
+// Value of a digit in any base up to 16, or 16 if the byte is not a digit.
+static inline uint8_t
+digit_value(uint8_t entry) {
+    switch (CLASS_OF(entry)) {
+        case CC_DIGIT:
+        case CC_HEX_LETTER:
+        case CC_PREFIX_B: return PAYLOAD_OF(entry);
+        default: return 16;
+    }
+}
 
-        case '~': {
-            tok->type = TOK_BITWISE_NOT;
-            return buff + 1;
-        }
+// Where SWAR is available, long literals are converted 8 digits at a time. Each
+// digit sits in its own byte of a 64 bit word with the first digit in the
+// lowest byte, and neighbouring lanes are merged pairwise until a single value
+// is left. Digits must already be validated.
+#ifdef PLATFORM_SWAR
 
-        case '*': {
-            tok->type = TOK_TIMES;
-            return buff + 1;
-        }
+static inline uint64_t
+load_eight(const char *digits) {
+    uint64_t word;
+    memcpy(&word, digits, sizeof(word));
+    return word;
+}
 
-        case '/': {
-            tok->type = TOK_DIVIDED_BY;
-            return buff + 1;
-        }
-        
-        case '%': {
-            tok->type = TOK_MODULO;
-            return buff + 1;
-        }
+static inline uint32_t
+swar_dec8(const char *digits) {
+    uint64_t x = load_eight(digits) & 0x0F0F0F0F0F0F0F0F;
+    x = ((x * 2561) >> 8) & 0x00FF00FF00FF00FF;
+    x = ((x * 6553601) >> 16) & 0x0000FFFF0000FFFF;
+    return (uint32_t)((x * 42949672960001) >> 32);
+}
 
-        case '+': {
-            tok->type = TOK_PLUS;
-            return buff + 1;
-        }
-        
-        case '-': {
-            tok->type = TOK_MINUS;
-            return buff + 1;
+static inline uint32_t
+swar_hex8(const char *digits) {
+    uint64_t x = load_eight(digits);
+
+    // Letters have bit 6 set, and their low nibble is 9 less than their value.
+    uint64_t letters = (x >> 6) & 0x0101010101010101;
+    x = (x & 0x0F0F0F0F0F0F0F0F) + letters * 9;
+
+    x = ((x & 0x00FF00FF00FF00FF) << 4) | ((x >> 8) & 0x00FF00FF00FF00FF);
+    x = ((x & 0x0000FFFF0000FFFF) << 8) | ((x >> 16) & 0x0000FFFF0000FFFF);
+    return (uint32_t)(((x & 0xFFFFFFFF) << 16) | (x >> 32));
+}
+
+static inline uint32_t
+swar_oct8(const char *digits) {
+    uint64_t x = load_eight(digits) & 0x0707070707070707;
+    x = ((x & 0x00FF00FF00FF00FF) << 3) | ((x >> 8) & 0x00FF00FF00FF00FF);
+    x = ((x & 0x0000FFFF0000FFFF) << 6) | ((x >> 16) & 0x0000FFFF0000FFFF);
+    return (uint32_t)(((x & 0xFFFFFFFF) << 12) | (x >> 32));
+}
+
+static inline uint8_t
+swar_bin8(const char *digits) {
+    // The multiply gathers bit 0 of every byte into the top byte, first digit
+    // highest.
+    uint64_t x = load_eight(digits) & 0x0101010101010101;
+    return (uint8_t)((x * 0x8040201008040201) >> 56);
+}
+#endif
+
+// Each parser below converts exactly count validated digits of its own base.
+// Decimal literals never have leading zeros, since those select octal.
+
+static MathErr
+parse_dec(const char *digits, size_t count, uint64_t *value) {
+    // UINT64_MAX has 20 digits, so anything shorter can not overflow.
+    if (count > 20) {
+        return MATH_ERR_LITERAL_OVERFLOW;
+    }
+
+    size_t safe = count < 20 ? count : 19;
+    uint64_t val = 0;
+
+#ifdef PLATFORM_SWAR
+    for (; safe >= 8; safe -= 8, digits += 8) {
+        val = val * 100000000 + swar_dec8(digits);
+    }
+#endif
+    for (; safe > 0; safe -= 1, digits += 1) {
+        val = val * 10 + (uint8_t)(*digits - '0');
+    }
+
+    if (count == 20) {
+        uint8_t last = (uint8_t)(*digits - '0');
+        if (val > UINT64_MAX / 10 || (val == UINT64_MAX / 10 && last > UINT64_MAX % 10)) {
+            return MATH_ERR_LITERAL_OVERFLOW;
         }
+        val = val * 10 + last;
+    }
+
+    *value = val;
+    return MATH_ERR_OK;
+}
+
+// Drops leading zeros from a power of two literal, and checks the significant
+// digits fit in 64 bits.
+static MathErr
+trim_pow2(const char **digits, size_t *count, uint8_t bits_per_digit) {
+    while (*count > 0 && **digits == '0') {
+        *digits += 1;
+        *count -= 1;
+    }
+
+    if (*count == 0) {
+        return MATH_ERR_OK;
+    }
+
+    // The leading digit may use fewer bits than a full digit.
+    uint8_t lead = digit_value(classify(**digits));
+    uint8_t lead_bits = 0;
+    while (lead != 0) {
+        lead >>= 1;
+        lead_bits += 1;
+    }
+
+    if ((*count - 1) * bits_per_digit + lead_bits > 64) {
+        return MATH_ERR_LITERAL_OVERFLOW;
+    }
+    return MATH_ERR_OK;
+}
+
+static MathErr
+parse_hex(const char *digits, size_t count, uint64_t *value) {
+    MathErr err = trim_pow2(&digits, &count, 4);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    uint64_t val = 0;
+#ifdef PLATFORM_SWAR
+    for (; count >= 8; count -= 8, digits += 8) {
+        val = (val << 32) | swar_hex8(digits);
+    }
+#endif
+    for (; count > 0; count -= 1, digits += 1) {
+        val = (val << 4) | digit_value(classify(*digits));
+    }
+
+    *value = val;
+    return MATH_ERR_OK;
+}
+
+static MathErr
+parse_oct(const char *digits, size_t count, uint64_t *value) {
+    MathErr err = trim_pow2(&digits, &count, 3);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    uint64_t val = 0;
+#ifdef PLATFORM_SWAR
+    for (; count >= 8; count -= 8, digits += 8) {
+        val = (val << 24) | swar_oct8(digits);
+    }
+#endif
+    for (; count > 0; count -= 1, digits += 1) {
+        val = (val << 3) | (uint8_t)(*digits - '0');
+    }
 
-        case '<': {
-            if (buff[1] == '<') {
-                tok->type = TOK_BITWISE_LEFT_SHIFT;
-                return buff + 2;
+    *value = val;
+    return MATH_ERR_OK;
+}
+
+static MathErr
+parse_bin(const char *digits, size_t count, uint64_t *value) {
+    MathErr err = trim_pow2(&digits, &count, 1);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    uint64_t val = 0;
+#ifdef PLATFORM_SWAR
+    for (; count >= 8; count -= 8, digits += 8) {
+        val = (val << 8) | swar_bin8(digits);
+    }
+#endif
+    for (; count > 0; count -= 1, digits += 1) {
+        val = (val << 1) | (uint8_t)(*digits - '0');
+    }
+
+    *value = val;
+    return MATH_ERR_OK;
+}
+
+// Lexes an integer literal. The class of the byte after a leading 0 selects
+// the base:
+//  * Binary numbers start with 0b, IE 0b1011
+//  * Octal numbers start with a leading 0, IE 0123
+//  * Hexadecimal numbers start with 0x, IE 0xA4
+//
+// The digits are scanned once to find where the literal ends, then handed to
+// the parser for their base. A literal running straight into a digit or letter
+// that is not valid for its base, IE 0b102 or 12ab, is malformed.
+static MathErr
+lex_integer(Token *tok, const char *buff, const char *limit, const char **end) {
+    uint8_t base = 10;
+    const char *num_start = buff;
+
+    if (buff[0] == '0') {
+        switch (CLASS_OF(classify(byte_at(buff + 1, limit)))) {
+            case CC_DIGIT: {
+                base = 8;
+                num_start = buff + 1;
+                break;
+            }
+
+            case CC_PREFIX_X: {
+                base = 16;
+                num_start = buff + 2;
+                break;
             }
-            return buff;
-        }
 
-        case '>': {
-            if (buff[1] == '>') {
-                tok->type = TOK_BITWISE_RIGHT_SHIFT;
-                return buff + 2;
+            case CC_PREFIX_B: {
+                base = 2;
+                num_start = buff + 2;
+                break;
             }
-            return buff;
         }
+    }
+
+    const char *num_end = num_start;
+    uint8_t entry = classify(byte_at(num_end, limit));
+    while (digit_value(entry) < base) {
+        num_end += 1;
+        entry = classify(byte_at(num_end, limit));
+    }
 
-        case '&': {
-            tok->type = TOK_BITWISE_AND;
-            return buff + 1;
+    if (num_end == num_start || CLASS_OF(entry) >= CC_DIGIT) {
+        return MATH_ERR_MALFORMED_EXPR;
+    }
+
+    size_t count = (size_t)(num_end - num_start);
+    MathErr err;
+    switch (base) {
+        case 16:
+            tok->flags = TOK_FLAG_BASE_HEX;
+            err = parse_hex(num_start, count, &tok->value);
+            break;
+        case 8:
+            tok->flags = TOK_FLAG_BASE_OCT;
+            err = parse_oct(num_start, count, &tok->value);
+            break;
+        case 2:
+            tok->flags = TOK_FLAG_BASE_BIN;
+            err = parse_bin(num_start, count, &tok->value);
+            break;
+        default:
+            tok->flags = TOK_FLAG_BASE_DEC;
+            err = parse_dec(num_start, count, &tok->value);
+            break;
+    }
+
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+
+    tok->type = TOK_INTEGER;
+    *end = num_end;
+    return MATH_ERR_OK;
+}
+
+TokChar
+token_classify_char(char c, TokenType *type, uint8_t *digit) {
+    uint8_t entry = classify(c);
+    *digit = digit_value(entry);
+
+    switch (CLASS_OF(entry)) {
+        case CC_SPACE: return TOK_CHAR_SPACE;
+        case CC_OPERATOR:
+            *type = (TokenType)PAYLOAD_OF(entry);
+            return TOK_CHAR_OPERATOR;
+        case CC_DOUBLED:
+            *type = (TokenType)PAYLOAD_OF(entry);
+            return TOK_CHAR_DOUBLED;
+        case CC_DIGIT:
+        case CC_HEX_LETTER: return TOK_CHAR_DIGIT;
+        case CC_PREFIX_B: return TOK_CHAR_PREFIX_B;
+        case CC_PREFIX_X: return TOK_CHAR_PREFIX_X;
+        default: return TOK_CHAR_INVALID;
+    }
+}
+
+// The first byte of a token decides its class, and with it the path through
+// the lexer: single character operators are complete after one byte, doubled
+// operators need their second byte to match the first, and digits hand off to
+// the integer lexer.
+MathErr
+token_set_from_buf(Token *tok, const char *buff, size_t len, const char **end) {
+    const char *limit = buff + len;
+    uint8_t entry = classify(byte_at(buff, limit));
+
+    tok->flags = 0;
+    tok->value = 0;
+    switch (CLASS_OF(entry)) {
+        case CC_OPERATOR: {
+            tok->type = (TokenType)PAYLOAD_OF(entry);
+            *end = buff + 1;
+            return MATH_ERR_OK;
         }
 
-        case '^': {
-            tok->type = TOK_BITWISE_XOR;
-            return buff + 1;
+        case CC_DOUBLED: {
+            if (byte_at(buff + 1, limit) != buff[0]) {
+                return MATH_ERR_MALFORMED_EXPR;
+            }
+            tok->type = (TokenType)PAYLOAD_OF(entry);
+            *end = buff + 2;
+            return MATH_ERR_OK;
         }
 
-        case '|': {
-            tok->type = TOK_BITWISE_OR;
-            return buff + 1;
+        case CC_DIGIT: {
+            return lex_integer(tok, buff, limit, end);
         }
 
         default: {
-            // Try to parse a number if no operators were found.
-            int base = 10;
-            const char *num_start = buff;
-
-            // If the number starts with 0, it is either 0, or notation to represent
-            // a binary, octal or hexadecimal number:
-            //  * Binary numbers start with 0b, IE 0b1011
-            //  * Octal numbers start with a leading 0, IE 0123
-            //  * Hexadecimal numbers start with 0x, IE 0xA4
-            if (buff[0] == '0') {
-                if (buff[1] >= '0' && buff[1] <= '9') {
-                    // If there are more numbers following the leading 0, we are in
-                    // octal.
-                    base = 8;
-                    num_start = buff + 1;
-                } else if ( buff[1] == 'x') {
-                    // If the number starts with 0x, we are in hexadecimal.
-                    base = 16;
-                    num_start = buff + 2;
-                } if (buff[1] == 'b') {
-                    // If the number starts with 0b, we are in binary.
-                    base = 2;
-                    num_start = buff + 2;
+            return MATH_ERR_MALFORMED_EXPR;
+        }
+    }
+}
+
+MathErr
+token_set_from_str(Token *tok, const char *buff, const char **end) {
+    return token_set_from_buf(tok, buff, strlen(buff), end);
+}
+
+// States of a TokLexer between bytes.
+enum LexState {
+    LEX_IDLE, // Between tokens.
+    LEX_DOUBLED, // After the first half of a doubled operator, kept in first.
+    LEX_ZERO, // After a leading 0, which does not yet tell the base.
+    LEX_DIGITS, // Inside the digits of a literal in base.
+};
+
+void
+token_lexer_init(TokLexer *lexer) {
+    lexer->state = LEX_IDLE;
+}
+
+static void
+start_literal(TokLexer *lexer, uint8_t base, uint8_t value, bool has_digits) {
+    lexer->state = LEX_DIGITS;
+    lexer->base = base;
+    lexer->value = value;
+    lexer->has_digits = has_digits;
+    lexer->overflow = false;
+}
+
+// Adds a digit to the literal in progress. As in the parsers above, leading
+// zeros never count towards overflowing, but only being out of digits or
+// running into a byte that is not valid for the base decides the literal has
+// ended, so an overflow is only reported after that.
+static void
+add_digit(TokLexer *lexer, uint8_t digit) {
+    uint64_t val = lexer->value;
+    switch (lexer->base) {
+        case 16: lexer->overflow |= (val >> 60) != 0; val = (val << 4) | digit; break;
+        case 8: lexer->overflow |= (val >> 61) != 0; val = (val << 3) | digit; break;
+        case 2: lexer->overflow |= (val >> 63) != 0; val = (val << 1) | digit; break;
+        default: lexer->overflow |= val > (UINT64_MAX - digit) / 10; val = val * 10 + digit; break;
+    }
+    lexer->value = val;
+    lexer->has_digits = true;
+}
+
+// Ends the literal in progress at a byte of class entry.
+static MathErr
+end_literal(TokLexer *lexer, uint8_t entry, TokenEmit emit, void *context) {
+    lexer->state = LEX_IDLE;
+    if (! lexer->has_digits || CLASS_OF(entry) >= CC_DIGIT) {
+        return MATH_ERR_MALFORMED_EXPR;
+    } else if (lexer->overflow) {
+        return MATH_ERR_LITERAL_OVERFLOW;
+    }
+    return emit(context, TOK_INTEGER, lexer->value);
+}
+
+// Runs a single byte through the lexer. A byte which ends a literal also
+// starts whatever comes next, so it goes around again once the literal has
+// been handed on.
+static MathErr
+lex_byte(TokLexer *lexer, char c, TokenEmit emit, void *context) {
+    uint8_t entry = classify(c);
+    while (true) {
+        switch (lexer->state) {
+            case LEX_IDLE: {
+                switch (CLASS_OF(entry)) {
+                    case CC_SPACE: return MATH_ERR_OK;
+                    case CC_OPERATOR: return emit(context, (TokenType)PAYLOAD_OF(entry), 0);
+                    case CC_DOUBLED: {
+                        lexer->state = LEX_DOUBLED;
+                        lexer->first = c;
+                        return MATH_ERR_OK;
+                    }
+                    case CC_DIGIT: {
+                        if (c == '0') {
+                            lexer->state = LEX_ZERO;
+                        } else {
+                            start_literal(lexer, 10, PAYLOAD_OF(entry), true);
+                        }
+                        return MATH_ERR_OK;
+                    }
+                    default: return MATH_ERR_MALFORMED_EXPR;
                 }
             }
 
-            // Ensure that parsing big numbers will work on this hardware.
-            assert(sizeof(unsigned long long) == sizeof(uint64_t));
-            
-            char *end_ptr;
-            tok->value = strtoull(num_start, &end_ptr, base);
-            tok->type = TOK_INTEGER;
+            case LEX_DOUBLED: {
+                lexer->state = LEX_IDLE;
+                if (c != lexer->first) {
+                    return MATH_ERR_MALFORMED_EXPR;
+                }
+                return emit(context, (TokenType)PAYLOAD_OF(entry), 0);
+            }
+
+            case LEX_ZERO: {
+                switch (CLASS_OF(entry)) {
+                    case CC_DIGIT: start_literal(lexer, 8, 0, false); continue;
+                    case CC_PREFIX_X: start_literal(lexer, 16, 0, false); return MATH_ERR_OK;
+                    case CC_PREFIX_B: start_literal(lexer, 2, 0, false); return MATH_ERR_OK;
+                    default: {
+                        // Just a 0, which ends here.
+                        start_literal(lexer, 10, 0, true);
+                        continue;
+                    }
+                }
+            }
+
+            default: {
+                uint8_t digit = digit_value(entry);
+                if (digit < lexer->base) {
+                    add_digit(lexer, digit);
+                    return MATH_ERR_OK;
+                }
+
+                MathErr err = end_literal(lexer, entry, emit, context);
+                if (err != MATH_ERR_OK) {
+                    return err;
+                }
+                continue;
+            }
+        }
+    }
+}
+
+MathErr
+token_lexer_feed(TokLexer *lexer, const char *buff, size_t len, TokenEmit emit, void *context) {
+    for (size_t i = 0; i < len; i++) {
+        MathErr err = lex_byte(lexer, buff[i], emit, context);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+    }
+    return MATH_ERR_OK;
+}
 
-            return end_ptr;
+MathErr
+token_lexer_finish(TokLexer *lexer, TokenEmit emit, void *context) {
+    uint8_t state = lexer->state;
+    lexer->state = LEX_IDLE;
+    switch (state) {
+        case LEX_DOUBLED: return MATH_ERR_MALFORMED_EXPR;
+        case LEX_ZERO: return emit(context, TOK_INTEGER, 0);
+        case LEX_DIGITS: {
+            // The input ends as if on a null terminator.
+            lexer->state = LEX_DIGITS;
+            return end_literal(lexer, CHAR_CLASS(CC_INVALID, 0), emit, context);
         }
+        default: return MATH_ERR_OK;
     }
 }
 
@@ -6,6 +6,9 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "error.h"
+
+// Parenthesis must stay first, so that they can be found with a single compare.
 typedef enum TokenType {
     TOK_LEFT_PARENTHESIS,
     TOK_RIGHT_PARENTHESIS,
@@ -23,40 +26,116 @@ typedef enum TokenType {
     TOK_INTEGER
 } TokenType;
 
-// TODO: The below comment is probably wrong.
+#define TOK_TYPE_COUNT (TOK_INTEGER + 1)
 
 // Represents a single token of an expression. For example, in the expression
 // 12 * (3 + 4), '12', '*', '(', '3', '+', '4', and ')' are the tokens which
-// make it up. Each token has 4 connections to other tokens to form a graph. The
+// make it up. Each token has 5 connections to other tokens to form a graph. The
 // graph is used to parse the expression tree for evaluation.
 //
 // Prior to parsing, the expression can be thought of as a bidirectional linked
 // list of tokens. The *pre and *next pointers point to the previous and next
-// token in the list, respectively. 
+// token in the list, respectively. Parsing never modifies the list.
+//
+// During parsing, a binary tree is constructed in-place over the linked list
+// using the *left and *right pointers. Binary operators use both children,
+// while unary operators have a NULL *left and their operand in *right.
+// Parenthesis are not part of the tree: a '(' token instead points *left at the
+// root of the tree built for its group (NULL for an empty group), and *right at
+// its matching ')'. Each node of the tree points *parent back at the operator
+// it is an operand of, skipping over any parenthesis, and the root has a NULL
+// *parent.
 //
-// During parsing, a binary tree is constructed in-place from the linked list
-// using the *left and *right pointers, until we are left with a fully parsed
-// expression tree ready for evaluation.
+// The value field holds the literal numeric value of a TOK_INTEGER token. An
+// operator in the tree caches the value of its sub-tree there instead, which
+// is valid while its TOK_FLAG_DIRTY flag is clear. The other TOK_FLAG_* flags
+// record how the token was written, so that it can be edited a character at a
+// time.
 //
-// The value field can be thought of as metadata whose information differs based
-// on the token type. For TOK_INTEGER, this value is the literal numeric value
-// of the integer that the token represents. However, for operator tokens, the
-// value field holds a boolean (0 = false, 1 = true) indicating weather it can
-// be treated as a value, IE if it has been previously parsed into a sub-tree.
+// Inside an expression, tokens may instead be stored in a compact layout with
+// the same structure, see tok_pool.h.
 typedef struct Token {
     struct Token *pre;
     struct Token *next;
     struct Token *left;
     struct Token *right;
+    struct Token *parent;
 
     TokenType type;
+    uint8_t flags;
     uint64_t value;
 } Token;
 
+// The low 2 flags hold the base of a literal, whose digits follow its prefix
+// without leading zeros.
+#define TOK_FLAG_BASE_DEC 0x00
+#define TOK_FLAG_BASE_HEX 0x01
+#define TOK_FLAG_BASE_OCT 0x02
+#define TOK_FLAG_BASE_BIN 0x03
+#define TOK_FLAG_BASE_MASK 0x03
+
+// Whitespace came before the token.
+#define TOK_FLAG_SPACE 0x04
+
+// The cached value of an operator is stale, or its links to its operands have
+// changed since it was last evaluated. Set on a literal whose value changes
+// while there is no tree to mark instead.
+#define TOK_FLAG_DIRTY 0x08
+
 // Note: buff should be large enough to hold the maximum length string possible.
 // 20 characters plus null terminator will safely represent UINT64_MAX.
 bool token_to_str(const Token *tok, char *buff, size_t buff_size);
-const char * token_set_from_str(Token *tok, const char *buff);
+
+// Lexes the token at the start of buff, which must not be whitespace. On
+// success, *end is set to point just past the token. No more than len bytes
+// are ever read, so buff does not need to be null terminated.
+MathErr token_set_from_buf(Token *tok, const char *buff, size_t len, const char **end);
+MathErr token_set_from_str(Token *tok, const char *buff, const char **end);
+
+// Returns a pointer to the first non-whitespace character in the first len
+// bytes of buff, or buff + len if they are all whitespace.
+const char * token_skip_space(const char *buff, size_t len);
+
+// What a single character can contribute to an expression, for editors which
+// lex a keystroke at a time.
+typedef enum TokChar {
+    TOK_CHAR_INVALID,
+    TOK_CHAR_SPACE,
+    TOK_CHAR_OPERATOR,
+    TOK_CHAR_DOUBLED, // Half of an operator which is written twice, IE << and >>.
+    TOK_CHAR_DIGIT,
+    TOK_CHAR_PREFIX_B, // The binary prefix, which is also the hexadecimal digit B.
+    TOK_CHAR_PREFIX_X,
+} TokChar;
+
+// Classifies c. *type is set to the operator of an operator character, and
+// *digit to the value of c as a digit in bases up to 16, or 16 if it is not
+// one.
+TokChar token_classify_char(char c, TokenType *type, uint8_t *digit);
+
+// Receives each token completed by a TokLexer. Returning an error stops the
+// lexer, which passes the error on.
+typedef MathErr (*TokenEmit)(void *context, TokenType type, uint64_t value);
+
+// Lexes input which arrives in pieces, IE over a UART or from a pipe, without
+// ever holding more than the token in progress. Tokens are exactly those
+// token_set_from_buf would find in the whole input, and so are the errors.
+typedef struct TokLexer {
+    uint64_t value;
+    uint8_t state;
+    uint8_t base;
+    bool has_digits;
+    bool overflow;
+    char first;
+} TokLexer;
+
+void token_lexer_init(TokLexer *lexer);
+
+// Lexes the next len bytes of input, handing every token it completes to emit.
+MathErr token_lexer_feed(TokLexer *lexer, const char *buff, size_t len, TokenEmit emit, void *context);
+
+// Ends the input, completing the token in progress.
+MathErr token_lexer_finish(TokLexer *lexer, TokenEmit emit, void *context);
 
 void token_set_operator(Token *tok, TokenType type);
 void token_set_integer(Token *tok, uint64_t val);
@@ -0,0 +1,161 @@
+// Stack VM tests.
+
+#include <string.h>
+
+#include "unity.h"
+#include "bytecode.h"
+#include "expression.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint8_t g_arena[EXPR_ARENA_SIZE(MAX_TOKENS_PER_EXPR)];
+static uint8_t g_code_buff[BYTECODE_SIZE(MAX_TOKENS_PER_EXPR)];
+static Expression g_expr;
+static Bytecode g_code;
+
+// Checks compiling and running str gives what evaluating it does.
+static void
+check_round_trip(const char *str) {
+    uint64_t expected = 0, result = 0;
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    bytecode_init(&g_code, g_code_buff, sizeof(g_code_buff));
+    TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_set_from_str(&g_expr, str), str);
+
+    MathErr expected_err = expression_evaluate(&g_expr, &expected);
+    MathErr err = expression_compile(&g_expr, &g_code);
+    if (err == MATH_ERR_OK) {
+        err = bytecode_run(&g_code, &result);
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(expected_err, err, str);
+    if (expected_err == MATH_ERR_OK) {
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, result, str);
+    }
+}
+
+void round_trip() {
+    static const char *const exprs[] = {
+        "1 + 2 * 3",
+        "(1 + 2) * 3",
+        "100 - 7 - 3",
+        "1000 / 10 / 5 % 7",
+        "~-~1",
+        "-(5 - 8) * -2",
+        "0xF0 | 0x0F ^ 0xFF & 0x3C",
+        "1 << 63 >> 62",
+        "3 << 64 | 5 >> 200",
+        "255 + 256 + 65535 + 65536 + 4294967295 + 4294967296",
+        "18446744073709551615 * 18446744073709551615",
+        "18446744073709551615 / 0x100000000 % 1000",
+        "((((((7))))))",
+        "7 / (3 - 3)",
+        "7 % 0 + (1 / 0)",
+        "1 + 2 +",
+        "(1 + 2",
+        "1 2",
+        "",
+    };
+
+    for (size_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]); i++) {
+        check_round_trip(exprs[i]);
+    }
+}
+
+void literal_encoding() {
+    static const struct {
+        const char *str;
+        size_t size;
+    } cases[] = {
+        {"0", 2},
+        {"255", 2},
+        {"256", 3},
+        {"65535", 3},
+        {"65536", 5},
+        {"4294967295", 5},
+        {"4294967296", 9},
+        {"18446744073709551615", 9},
+    };
+
+    // Test each literal takes the shortest push which holds it.
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint64_t expected, result;
+        expression_init(&g_expr, g_arena, sizeof(g_arena));
+        bytecode_init(&g_code, g_code_buff, sizeof(g_code_buff));
+        TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, cases[i].str));
+        TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(&g_expr, &expected));
+        TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_compile(&g_expr, &g_code));
+        TEST_ASSERT_EQUAL_size_t_MESSAGE(cases[i].size, g_code.size, cases[i].str);
+        TEST_ASSERT_EQUAL(MATH_ERR_OK, bytecode_run(&g_code, &result));
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, result, cases[i].str);
+    }
+}
+
+void independent_program() {
+    uint64_t result;
+
+    // Test the program keeps its result after the expression changes.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    bytecode_init(&g_code, g_code_buff, sizeof(g_code_buff));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "6 * 7"));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_compile(&g_expr, &g_code));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "1 + 1"));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, bytecode_run(&g_code, &result));
+    TEST_ASSERT_EQUAL_UINT64(42, result);
+
+    // Test a program which does not fit fails, and leaves nothing to run.
+    static uint8_t small[4];
+    bytecode_init(&g_code, small, sizeof(small));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "1 + 2 + 3"));
+    TEST_ASSERT_EQUAL(MATH_ERR_OUT_OF_CODE, expression_compile(&g_expr, &g_code));
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, bytecode_run(&g_code, &result));
+}
+
+// Builds "1 + (1 + (... (1 + 1)))", which needs a value on the stack for each
+// literal, in a growable expression.
+static void
+build_nested(Expression *expr, int literals) {
+    expression_reset(expr);
+    for (int i = 1; i < literals; i++) {
+        TEST_ASSERT_TRUE(expression_append_int(expr, 1));
+        TEST_ASSERT_TRUE(expression_append_operator(expr, TOK_PLUS));
+        if (i != literals - 1) {
+            TEST_ASSERT_TRUE(expression_append_operator(expr, TOK_LEFT_PARENTHESIS));
+        }
+    }
+    TEST_ASSERT_TRUE(expression_append_int(expr, 1));
+    for (int i = 2; i < literals; i++) {
+        TEST_ASSERT_TRUE(expression_append_operator(expr, TOK_RIGHT_PARENTHESIS));
+    }
+}
+
+void stack_overflow() {
+    static uint8_t code_buff[BYTECODE_SIZE(4 * (EXPR_VM_STACK_DEPTH + 1))];
+    uint64_t result;
+    expression_init_growable(&g_expr, 64);
+    bytecode_init(&g_code, code_buff, sizeof(code_buff));
+
+    // Test the deepest program the stack holds runs.
+    build_nested(&g_expr, EXPR_VM_STACK_DEPTH);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_compile(&g_expr, &g_code));
+    TEST_ASSERT_EQUAL_size_t(EXPR_VM_STACK_DEPTH, g_code.depth);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, bytecode_run(&g_code, &result));
+    TEST_ASSERT_EQUAL_UINT64(EXPR_VM_STACK_DEPTH, result);
+
+    // Test one level deeper fails to compile, and leaves nothing to run.
+    build_nested(&g_expr, EXPR_VM_STACK_DEPTH + 1);
+    TEST_ASSERT_EQUAL(MATH_ERR_STACK_OVERFLOW, expression_compile(&g_expr, &g_code));
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, bytecode_run(&g_code, &result));
+
+    expression_free(&g_expr);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(round_trip);
+    RUN_TEST(literal_encoding);
+    RUN_TEST(independent_program);
+    RUN_TEST(stack_overflow);
+
+    return UNITY_END();
+}
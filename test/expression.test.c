@@ -0,0 +1,909 @@
+// Expression tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "expression.h"
+#include "operator.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint8_t g_arena[EXPR_ARENA_SIZE(MAX_TOKENS_PER_EXPR)];
+static uint8_t g_ref_arena[EXPR_ARENA_SIZE(MAX_TOKENS_PER_EXPR)];
+static Expression g_expr;
+static Expression g_ref;
+static ExprPreview g_preview;
+
+// Parses and evaluates str, leaving the value in result.
+static MathErr
+evaluate(const char *str, uint64_t *result) {
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    MathErr err = expression_set_from_str(&g_expr, str);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+    return expression_evaluate(&g_expr, result);
+}
+
+// Checks str evaluates to expected.
+static void
+check_value(const char *str, uint64_t expected) {
+    uint64_t result = 0;
+    TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, evaluate(str, &result), str);
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, result, str);
+}
+
+// Checks evaluating str fails with expected.
+static void
+check_error(const char *str, MathErr expected) {
+    uint64_t result = 0;
+    TEST_ASSERT_EQUAL_MESSAGE(expected, evaluate(str, &result), str);
+}
+
+void precedence() {
+    // Test each level binds tighter than the one below it, as in C.
+    check_value("2 + 3 * 4", 14);
+    check_value("2 * 3 + 4", 10);
+    check_value("1 << 2 + 1", 8);
+    check_value("1 + 2 << 1", 6);
+    check_value("12 & 6 << 1", 12);
+    check_value("3 ^ 5 & 6", 7);
+    check_value("1 | 6 ^ 3", 5);
+    check_value("6 & 3 | 8 ^ 12", 6);
+    check_value("7 % 4 * 3", 9);
+
+    // Test parenthesis override precedence.
+    check_value("(2 + 3) * 4", 20);
+    check_value("2 * (3 + (4 - 1))", 12);
+}
+
+void associativity() {
+    // Test operators of the same level group from the left.
+    check_value("10 - 4 - 3", 3);
+    check_value("100 / 10 / 5", 2);
+    check_value("100 % 7 % 3", 2);
+    check_value("256 >> 2 >> 1", 32);
+    check_value("1 << 2 << 3", 32);
+    check_value("10 - 4 + 3", 9);
+    check_value("2 * 9 / 4", 4);
+}
+
+void unary_chains() {
+    // Test unary operators apply from the inside out.
+    check_value("~-~1", (uint64_t)~-~1);
+    check_value("--5", 5);
+    check_value("-~0", 1);
+    check_value("+-+3", (uint64_t)-3);
+    check_value("~~~~7", 7);
+
+    // Test unary operators bind tighter than any binary one.
+    check_value("-2 * 3", (uint64_t)-6);
+    check_value("~1 & 6", 6);
+    check_value("2 - -2", 4);
+    check_value("-(2 + 3)", (uint64_t)-5);
+}
+
+void empty_groups() {
+    // Test an empty group is skipped over as if it was never there.
+    check_value("() 1", 1);
+    check_value("1 ()", 1);
+    check_value("2 * () 3", 6);
+    check_value("- () 5", (uint64_t)-5);
+
+    // Test a group holding nothing else is not a value.
+    check_error("()", MATH_ERR_MALFORMED_EXPR);
+    check_error("(())", MATH_ERR_MALFORMED_EXPR);
+    check_error("1 + ()", MATH_ERR_MALFORMED_EXPR);
+}
+
+void unmatched_parenthesis() {
+    check_error("(", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_error(")", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_error("((1)", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_error("(1))", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_error(")1(", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_error("1 + (2", MATH_ERR_PARENTHESIS_MISMATCH);
+
+    // Test a mismatch takes precedence over errors inside the expression.
+    check_error("1 / 0 + (", MATH_ERR_PARENTHESIS_MISMATCH);
+}
+
+void long_groups() {
+    static char str[128];
+
+    // Test parenthesis are found at every offset into an expression longer
+    // than the scan covers at once, including the tokens left over at its end.
+    for (size_t offset = 0; offset < 24; offset++) {
+        char *end = str;
+        for (size_t i = 0; i < offset; i++) {
+            end += sprintf(end, "- ");
+        }
+        strcpy(end, "(2 * 3) * (4)");
+        check_value(str, offset % 2 == 0 ? 24 : (uint64_t)-24);
+        strcpy(end, "(2 * 3");
+        check_error(str, MATH_ERR_PARENTHESIS_MISMATCH);
+        strcpy(end, "2) * 3");
+        check_error(str, MATH_ERR_PARENTHESIS_MISMATCH);
+    }
+
+    // Test groups nested deeper than the scan covers at once.
+    strcpy(str, "((((((((((((((((((((1 + 2) * 2))))))))))))))))))) + 1");
+    check_value(str, 7);
+    str[0] = ' ';
+    check_error(str, MATH_ERR_PARENTHESIS_MISMATCH);
+}
+
+void malformed() {
+    // Test operands must be separated by an operator.
+    check_error("1 2", MATH_ERR_MALFORMED_EXPR);
+    check_error("(1)(2)", MATH_ERR_MALFORMED_EXPR);
+    check_error("1 ~ 2", MATH_ERR_MALFORMED_EXPR);
+
+    // Test an operator must have its operands.
+    check_error("", MATH_ERR_MALFORMED_EXPR);
+    check_error("1 +", MATH_ERR_MALFORMED_EXPR);
+    check_error("* 2", MATH_ERR_MALFORMED_EXPR);
+    check_error("1 * / 2", MATH_ERR_MALFORMED_EXPR);
+    check_error("-", MATH_ERR_MALFORMED_EXPR);
+
+    // Test a malformed expression fails before it divides by zero.
+    check_error("5 / 0 2", MATH_ERR_MALFORMED_EXPR);
+}
+
+// Parses and evaluates the first len characters of str, copied to a heap
+// buffer of exactly that size so reading past it is caught.
+static MathErr
+evaluate_buf(const char *str, size_t len, uint64_t *result) {
+    char *buff = malloc(len == 0 ? 1 : len);
+    TEST_ASSERT_NOT_NULL(buff);
+    memcpy(buff, str, len);
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    MathErr err = expression_set_from_buf(&g_expr, buff, len);
+    free(buff);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+    return expression_evaluate(&g_expr, result);
+}
+
+void bounded_text() {
+    uint64_t result = 0;
+
+    // Test text past the length is never read, even inside a token.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate_buf("1+23", 3, &result));
+    TEST_ASSERT_EQUAL_UINT64(3, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate_buf("12+3", 2, &result));
+    TEST_ASSERT_EQUAL_UINT64(12, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate_buf("0x1F", 3, &result));
+    TEST_ASSERT_EQUAL_UINT64(1, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate_buf("(7) * 2", 3, &result));
+    TEST_ASSERT_EQUAL_UINT64(7, result);
+
+    // Test text cut short after an operator or a prefix is incomplete.
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, evaluate_buf("1+23", 2, &result));
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, evaluate_buf("1<<2", 3, &result));
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, evaluate_buf("1<<2", 2, &result));
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, evaluate_buf("0x1F", 2, &result));
+    TEST_ASSERT_EQUAL(MATH_ERR_PARENTHESIS_MISMATCH, evaluate_buf("(1)", 2, &result));
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, evaluate_buf("7", 0, &result));
+}
+
+void division_by_zero() {
+    check_error("1 / 0", MATH_ERR_DIV_BY_ZERO);
+    check_error("1 % 0", MATH_ERR_DIV_BY_ZERO);
+    check_error("0 / 0", MATH_ERR_DIV_BY_ZERO);
+    check_error("7 / (3 - 3)", MATH_ERR_DIV_BY_ZERO);
+    check_error("1 + 7 % (2 * 0) * 3", MATH_ERR_DIV_BY_ZERO);
+
+    // Test dividing by a non-zero value still works around it.
+    check_value("7 / (3 - 2) % 4", 3);
+}
+
+void wide_shifts() {
+    uint64_t result;
+
+    // Test the widest shifts which still keep a bit.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate("1 << 63", &result));
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)1 << 63, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate("0x8000000000000000 >> 63", &result));
+    TEST_ASSERT_EQUAL_UINT64(1, result);
+
+    // Test shifting by the width or more shifts every bit out, rather than
+    // wrapping the count around as x86 does.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate("1 << 64", &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate("1 << 200", &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate("0xFFFFFFFFFFFFFFFF >> 64", &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+
+    // Test negative counts are huge unsigned ones.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate("1 << -1", &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate("1 >> -450", &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+
+    // Test the operations directly, as every evaluator calls them.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, operation_shift_left(1, 7351, &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, operation_shift_right(UINT64_MAX, UINT64_MAX, &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+}
+
+void sized_matches_full_width() {
+    // Literals fit in a byte, and only literals are divided or shifted right,
+    // so truncating the full width result gives the result in every width.
+    static const char *const exprs[] = {
+        "1 << 200", "3 << 64", "255 << 7", "255 << 8", "255 << 15", "255 << 31", "255 << 63", "128 >> 7", "128 >> 8",
+        "200 >> 70", "(1 << 100) + 5", "-1 << 65", "~0 - 255 * 255", "(3 + 4) << 6", "-(200 / 7) ^ 200 % 7", "~~-5",
+    };
+
+    for (size_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]); i++) {
+        uint64_t full;
+        TEST_ASSERT_EQUAL(MATH_ERR_OK, evaluate(exprs[i], &full));
+        for (SizeMode mode = SIZE_MODE_BYTE; mode <= SIZE_MODE_QWORD; mode++) {
+            uint64_t sized;
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate_sized(&g_expr, mode, &sized));
+            TEST_ASSERT_EQUAL_UINT64_MESSAGE(number_truncate(full, mode), sized, exprs[i]);
+        }
+    }
+}
+
+// Types str into expr a keystroke at a time.
+static void
+type(Expression *expr, const char *str) {
+    for (const char *c = str; *c != '\0'; c++) {
+        TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_feed_char(expr, *c), str);
+    }
+}
+
+// Writes the tokens of expr to a static buffer.
+static const char *
+write_text(const Expression *expr, char *buff, size_t size) {
+    Sink sink;
+    sink_init(&sink, buff, size, NULL, NULL);
+    TEST_ASSERT_TRUE(expression_write(expr, &sink));
+    sink_flush(&sink);
+    return buff;
+}
+
+// Checks expr holds the same tokens as str parsed afresh, and evaluates the
+// same way.
+static void
+check_same_as_parsed(Expression *expr, const char *str) {
+    static char text[512], ref_text[512];
+    expression_init(&g_ref, g_ref_arena, sizeof(g_ref_arena));
+    TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_set_from_str(&g_ref, str), str);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(write_text(&g_ref, ref_text, sizeof(ref_text)),
+                                     write_text(expr, text, sizeof(text)), str);
+
+    uint64_t result = 0, expected = 0;
+    MathErr expected_err = expression_evaluate(&g_ref, &expected);
+    TEST_ASSERT_EQUAL_MESSAGE(expected_err, expression_evaluate(expr, &result), str);
+    if (expected_err == MATH_ERR_OK) {
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, result, str);
+    }
+}
+
+static const char *const g_typed[] = {
+    "0x1F + 3", "0b1011 << 2", "017 * 9 - 0", "(12 - 0xa) >> 1", "~-5 % 3", "18446744073709551615 / 0xfFfF",
+    "0 0x10", "1 2", "(((7)))", "0b1>>0", "45 | 0B10 ^ 0X7 & 0 ",
+};
+#define TYPED_COUNT (sizeof(g_typed) / sizeof(g_typed[0]))
+
+void typing_matches_parsing() {
+    // Test typing gives what parsing gives, after every keystroke which leaves
+    // nothing held back.
+    for (size_t i = 0; i < TYPED_COUNT; i++) {
+        char prefix[64];
+        expression_init(&g_expr, g_arena, sizeof(g_arena));
+        for (size_t len = 1; len <= strlen(g_typed[i]); len++) {
+            TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_feed_char(&g_expr, g_typed[i][len - 1]), g_typed[i]);
+            memcpy(prefix, g_typed[i], len);
+            prefix[len] = '\0';
+            if (g_expr.pending == 0) {
+                check_same_as_parsed(&g_expr, prefix);
+            }
+        }
+    }
+}
+
+void literal_extension() {
+    uint64_t result;
+
+    // Test digits extend a literal in its own base.
+    const char *const extended[] = {"0x1f", "0X1F", "0b10", "077", "0", "07", "123", "0x0", "0b0"};
+    for (size_t i = 0; i < sizeof(extended) / sizeof(extended[0]); i++) {
+        expression_init(&g_expr, g_arena, sizeof(g_arena));
+        type(&g_expr, extended[i]);
+        TEST_ASSERT_EQUAL_size_t(1, g_expr.size);
+        check_same_as_parsed(&g_expr, extended[i]);
+    }
+
+    // Test a prefix is held until a digit completes it, and a doubled operator
+    // until its second half.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    type(&g_expr, "0x");
+    TEST_ASSERT_EQUAL_size_t(0, g_expr.size);
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, expression_feed_char(&g_expr, '+'));
+    type(&g_expr, "A <");
+    TEST_ASSERT_EQUAL_size_t(1, g_expr.size);
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, expression_feed_char(&g_expr, '>'));
+    type(&g_expr, "< 1");
+    check_same_as_parsed(&g_expr, "0xA << 1");
+
+    // Test digits outside the base, and literals growing past 64 bits, are
+    // refused without changing anything.
+    const struct {
+        const char *typed;
+        char next;
+        MathErr err;
+    } refused[] = {
+        {"0b1", '2', MATH_ERR_MALFORMED_EXPR},
+        {"07", '8', MATH_ERR_MALFORMED_EXPR},
+        {"0", '9', MATH_ERR_MALFORMED_EXPR},
+        {"12", 'a', MATH_ERR_MALFORMED_EXPR},
+        {"0x", 'g', MATH_ERR_MALFORMED_EXPR},
+        {"18446744073709551615", '0', MATH_ERR_LITERAL_OVERFLOW},
+        {"1844674407370955161", '6', MATH_ERR_LITERAL_OVERFLOW},
+        {"0xFFFFFFFFFFFFFFFF", '0', MATH_ERR_LITERAL_OVERFLOW},
+        {"01777777777777777777777", '7', MATH_ERR_LITERAL_OVERFLOW},
+    };
+    for (size_t i = 0; i < sizeof(refused) / sizeof(refused[0]); i++) {
+        expression_init(&g_expr, g_arena, sizeof(g_arena));
+        type(&g_expr, refused[i].typed);
+        TEST_ASSERT_EQUAL_MESSAGE(refused[i].err, expression_feed_char(&g_expr, refused[i].next), refused[i].typed);
+        if (g_expr.pending == 0) {
+            check_same_as_parsed(&g_expr, refused[i].typed);
+        }
+    }
+
+    // Test the largest decimal literal can still be typed.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    type(&g_expr, "1844674407370955161");
+    type(&g_expr, "5");
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(&g_expr, &result));
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, result);
+}
+
+void backspace_matches_parsing() {
+    // Test deleting a character at a time, across literals, prefixes,
+    // operators and spaces, gives what parsing the remaining text gives.
+    for (size_t i = 0; i < TYPED_COUNT; i++) {
+        char prefix[64];
+        expression_init(&g_expr, g_arena, sizeof(g_arena));
+        type(&g_expr, g_typed[i]);
+        for (size_t len = strlen(g_typed[i]); len > 0; len--) {
+            TEST_ASSERT_TRUE_MESSAGE(expression_backspace(&g_expr), g_typed[i]);
+            memcpy(prefix, g_typed[i], len - 1);
+            prefix[len - 1] = '\0';
+            if (g_expr.pending == 0) {
+                check_same_as_parsed(&g_expr, prefix);
+            }
+        }
+        TEST_ASSERT_EQUAL_size_t(0, g_expr.size);
+        TEST_ASSERT_FALSE(expression_backspace(&g_expr));
+    }
+
+    // Test a run of whitespace, like leading zeros after a prefix, is deleted
+    // as one.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    type(&g_expr, "5 *   0x01");
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    type(&g_expr, "2");
+    check_same_as_parsed(&g_expr, "5 * 2");
+
+    // Test a prefix comes back once its last digit is deleted, and typing
+    // after it carries on in its base.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    type(&g_expr, "1 + 0b1");
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    type(&g_expr, "11");
+    check_same_as_parsed(&g_expr, "1 + 0b11");
+
+    // Test deleting the second half of a doubled operator holds the first.
+    for (int i = 0; i < 7; i++) {
+        TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    }
+    check_same_as_parsed(&g_expr, "1");
+    type(&g_expr, "<<2");
+    check_same_as_parsed(&g_expr, "1 << 2");
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    type(&g_expr, "<3");
+    check_same_as_parsed(&g_expr, "1 << 3");
+}
+
+void cursor_edits() {
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    type(&g_expr, "1 + 3");
+
+    // Test typing in the middle inserts before the token after the cursor.
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 2));
+    type(&g_expr, "2*");
+    check_same_as_parsed(&g_expr, "1 + 2 * 3");
+
+    // Test a digit typed straight after a literal extends it, but never joins
+    // onto the literal after the cursor.
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 1));
+    type(&g_expr, "0");
+    check_same_as_parsed(&g_expr, "10 + 2 * 3");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 4));
+    type(&g_expr, "5");
+    check_same_as_parsed(&g_expr, "10 + 2 * 5 3");
+
+    // Test deleting in the middle, and at the start.
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    check_same_as_parsed(&g_expr, "10 + 2 * 3");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 0));
+    TEST_ASSERT_FALSE(expression_backspace(&g_expr));
+    type(&g_expr, "-");
+    check_same_as_parsed(&g_expr, "-10 + 2 * 3");
+
+    // Test parsing leaves the cursor at the end.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "6 * 7"));
+    type(&g_expr, "1");
+    check_same_as_parsed(&g_expr, "6 * 71");
+
+    // Test the cursor must stay inside the expression, and can not move while
+    // a prefix is held.
+    TEST_ASSERT_FALSE(expression_set_cursor(&g_expr, -1));
+    TEST_ASSERT_FALSE(expression_set_cursor(&g_expr, 4));
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 3));
+    type(&g_expr, " 0");
+    TEST_ASSERT_EQUAL_size_t(4, g_expr.size);
+    type(&g_expr, "x");
+    TEST_ASSERT_FALSE(expression_set_cursor(&g_expr, 0));
+    type(&g_expr, "2");
+    check_same_as_parsed(&g_expr, "6 * 71 0x2");
+}
+
+void cached_values_follow_edits() {
+    uint64_t result;
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK,
+                      expression_set_from_str(&g_expr, "((1 + 2) * (3 + 4)) - ((5 << 6) | (7 ^ 8)) / 9 % 10"));
+    check_same_as_parsed(&g_expr, "((1 + 2) * (3 + 4)) - ((5 << 6) | (7 ^ 8)) / 9 % 10");
+
+    // Test evaluating again without an edit gives the same value.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(&g_expr, &result));
+    TEST_ASSERT_EQUAL_UINT64(21 - (320 | 15) / 9 % 10, result);
+
+    // Test editing literals deep in the tree, on both sides of the root.
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 5));
+    type(&g_expr, "5");
+    check_same_as_parsed(&g_expr, "((1 + 25) * (3 + 4)) - ((5 << 6) | (7 ^ 8)) / 9 % 10");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 23));
+    type(&g_expr, "0");
+    check_same_as_parsed(&g_expr, "((1 + 25) * (3 + 4)) - ((5 << 6) | (70 ^ 8)) / 9 % 10");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 5));
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    check_same_as_parsed(&g_expr, "((1 + 2) * (3 + 4)) - ((5 << 6) | (70 ^ 8)) / 9 % 10");
+
+    // Test adding and removing tokens, which rebuilds the tree around the
+    // values still cached in it.
+    TEST_ASSERT_TRUE(expression_insert_int(&g_expr, 100, 31));
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_PLUS, 31));
+    check_same_as_parsed(&g_expr, "((1 + 2) * (3 + 4)) - ((5 << 6) | (70 ^ 8)) / 9 % 10 + 100");
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 13));
+    check_same_as_parsed(&g_expr, "((1 + 2) * (3 + 4)) ((5 << 6) | (70 ^ 8)) / 9 % 10 + 100");
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_BITWISE_XOR, 13));
+    check_same_as_parsed(&g_expr, "((1 + 2) * (3 + 4)) ^ ((5 << 6) | (70 ^ 8)) / 9 % 10 + 100");
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 6));
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_MINUS, 6));
+    check_same_as_parsed(&g_expr, "((1 + 2) - (3 + 4)) ^ ((5 << 6) | (70 ^ 8)) / 9 % 10 + 100");
+
+    // Test several edits between evaluations, including ones made before the
+    // tree is rebuilt.
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_BITWISE_NOT, 8));
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 3));
+    type(&g_expr, "1");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 20));
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    type(&g_expr, "3");
+    check_same_as_parsed(&g_expr, "((11 + 2) - (~3 + 4)) ^ ((5 << 3) | (70 ^ 8)) / 9 % 10 + 100");
+
+    // Test compacting, then editing a literal which moved.
+    expression_compact(&g_expr);
+    check_same_as_parsed(&g_expr, "((11 + 2) - (~3 + 4)) ^ ((5 << 3) | (70 ^ 8)) / 9 % 10 + 100");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 26));
+    type(&g_expr, "1");
+    check_same_as_parsed(&g_expr, "((11 + 2) - (~3 + 4)) ^ ((5 << 3) | (70 ^ 81)) / 9 % 10 + 100");
+
+    // Test a division by zero introduced by an edit, and then taken away.
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 30));
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    type(&g_expr, "0");
+    check_same_as_parsed(&g_expr, "((11 + 2) - (~3 + 4)) ^ ((5 << 3) | (70 ^ 81)) / 0 % 10 + 100");
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    type(&g_expr, "7");
+    check_same_as_parsed(&g_expr, "((11 + 2) - (~3 + 4)) ^ ((5 << 3) | (70 ^ 81)) / 7 % 10 + 100");
+}
+
+// Checks the preview of expr matches the preview of a fresh parse of str, which
+// has no state attached.
+static void
+check_preview_as_parsed(Expression *expr, const char *str) {
+    expression_init(&g_ref, g_ref_arena, sizeof(g_ref_arena));
+    TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_set_from_str(&g_ref, str), str);
+
+    uint64_t result = 0, expected = 0;
+    MathErr expected_err = expression_preview(&g_ref, &expected);
+    TEST_ASSERT_EQUAL_MESSAGE(expected_err, expression_preview(expr, &result), str);
+    if (expected_err == MATH_ERR_OK) {
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, result, str);
+    }
+}
+
+void preview_incomplete() {
+    const struct {
+        const char *str;
+        MathErr err;
+        uint64_t expected;
+    } cases[] = {
+        {"1+", MATH_ERR_OK, 1},
+        {"(2*3", MATH_ERR_OK, 6},
+        {"5<<", MATH_ERR_OK, 5},
+        {"(0x3F & (5 << 2", MATH_ERR_OK, 20},
+        {"2 * (3 + ", MATH_ERR_OK, 6},
+        {"~(", MATH_ERR_MALFORMED_EXPR, 0},
+        {"1 + 2 3 * 4", MATH_ERR_OK, 3},
+        {"(1 + 2))", MATH_ERR_OK, 3},
+        {"8 / 0", MATH_ERR_DIV_BY_ZERO, 0},
+        {"", MATH_ERR_MALFORMED_EXPR, 0},
+        {"* 3", MATH_ERR_MALFORMED_EXPR, 0},
+    };
+
+    // Test with and without state attached.
+    for (int attached = 0; attached <= 1; attached++) {
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+            uint64_t result = 0;
+            expression_init(&g_expr, g_arena, sizeof(g_arena));
+            if (attached) {
+                expression_attach_preview(&g_expr, &g_preview);
+            }
+            TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_set_from_str(&g_expr, cases[i].str), cases[i].str);
+            TEST_ASSERT_EQUAL_MESSAGE(cases[i].err, expression_preview(&g_expr, &result), cases[i].str);
+            if (cases[i].err == MATH_ERR_OK) {
+                TEST_ASSERT_EQUAL_UINT64_MESSAGE(cases[i].expected, result, cases[i].str);
+            }
+        }
+    }
+}
+
+void preview_while_typing() {
+    // Test the kept state previews what starting over does after every
+    // keystroke, and what evaluating does once the expression is complete.
+    for (size_t i = 0; i < TYPED_COUNT; i++) {
+        char prefix[64];
+        expression_init(&g_expr, g_arena, sizeof(g_arena));
+        expression_attach_preview(&g_expr, &g_preview);
+        for (size_t len = 1; len <= strlen(g_typed[i]); len++) {
+            TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_feed_char(&g_expr, g_typed[i][len - 1]), g_typed[i]);
+            memcpy(prefix, g_typed[i], len);
+            prefix[len] = '\0';
+            if (g_expr.pending == 0) {
+                check_preview_as_parsed(&g_expr, prefix);
+            }
+        }
+
+        uint64_t previewed = 0, evaluated = 0;
+        if (expression_evaluate(&g_expr, &evaluated) == MATH_ERR_OK) {
+            TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_preview(&g_expr, &previewed), g_typed[i]);
+            TEST_ASSERT_EQUAL_UINT64_MESSAGE(evaluated, previewed, g_typed[i]);
+        }
+    }
+
+    // Test deleting back a keystroke at a time, past tokens already consumed.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    expression_attach_preview(&g_expr, &g_preview);
+    const char *typed = "(12 + 34) * 5 - 6";
+    type(&g_expr, typed);
+    for (size_t len = strlen(typed); len-- > 0;) {
+        char prefix[64];
+        memcpy(prefix, typed, len);
+        prefix[len] = '\0';
+        TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+        check_preview_as_parsed(&g_expr, prefix);
+    }
+}
+
+void preview_after_edits() {
+    uint64_t result;
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    expression_attach_preview(&g_expr, &g_preview);
+    type(&g_expr, "12 + 34 * 5 - (6");
+    check_preview_as_parsed(&g_expr, "12 + 34 * 5 - (6");
+
+    // Test editing, deleting and inserting tokens the preview has consumed.
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 1));
+    type(&g_expr, "9");
+    check_preview_as_parsed(&g_expr, "129 + 34 * 5 - (6");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, 3));
+    TEST_ASSERT_TRUE(expression_backspace(&g_expr));
+    check_preview_as_parsed(&g_expr, "129 + 3 * 5 - (6");
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 3));
+    check_preview_as_parsed(&g_expr, "129 + 3 5 - (6");
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_BITWISE_LEFT_SHIFT, 3));
+    check_preview_as_parsed(&g_expr, "129 + 3 << 5 - (6");
+    TEST_ASSERT_TRUE(expression_insert_int(&g_expr, 7, 0));
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_MINUS, 1));
+    check_preview_as_parsed(&g_expr, "7 - 129 + 3 << 5 - (6");
+
+    // Test compacting, and typing on at the end afterwards.
+    expression_compact(&g_expr);
+    check_preview_as_parsed(&g_expr, "7 - 129 + 3 << 5 - (6");
+    TEST_ASSERT_TRUE(expression_set_cursor(&g_expr, (int)g_expr.size));
+    type(&g_expr, "0) + 1");
+    check_preview_as_parsed(&g_expr, "7 - 129 + 3 << 5 - (60) + 1");
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(&g_expr, &result));
+    check_value("7 - 129 + 3 << 5 - (60) + 1", result);
+
+    // Test parsing over the expression starts the preview over.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "2 * (3"));
+    check_preview_as_parsed(&g_expr, "2 * (3");
+
+    // Test detaching goes back to starting over on every call.
+    expression_attach_preview(&g_expr, NULL);
+    type(&g_expr, " + 4");
+    check_preview_as_parsed(&g_expr, "2 * (3 + 4");
+}
+
+void context_pool() {
+    Expression *taken[EXPR_CONTEXT_COUNT];
+    uint64_t result;
+
+    // Test every context can be taken once, and holds a whole expression.
+    for (size_t i = 0; i < EXPR_CONTEXT_COUNT; i++) {
+        taken[i] = expression_take_reference();
+        TEST_ASSERT_NOT_NULL(taken[i]);
+        for (size_t j = 0; j < i; j++) {
+            TEST_ASSERT_TRUE(taken[i] != taken[j]);
+        }
+        TEST_ASSERT_EQUAL_size_t(0, taken[i]->size);
+        for (size_t j = 0; j < MAX_TOKENS_PER_EXPR - 1; j++) {
+            TEST_ASSERT_TRUE(j % 2 == 0 ? expression_append_int(taken[i], i) : expression_append_operator(taken[i], TOK_PLUS));
+        }
+    }
+
+    // Test the pool is then exhausted, and returning caller provided storage
+    // does not add to it.
+    TEST_ASSERT_NULL(expression_take_reference());
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    expression_return_reference(&g_expr);
+    TEST_ASSERT_NULL(expression_take_reference());
+
+    // Test a returned context is taken again, and starts out empty.
+    expression_return_reference(taken[3]);
+    Expression *again = expression_take_reference();
+    TEST_ASSERT_EQUAL_PTR(taken[3], again);
+    TEST_ASSERT_EQUAL_size_t(0, again->size);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(again, "6 * 7"));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(again, &result));
+    TEST_ASSERT_EQUAL_UINT64(42, result);
+    TEST_ASSERT_NULL(expression_take_reference());
+
+    // Test the others were left alone.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(taken[0], &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(taken[1], &result));
+    TEST_ASSERT_EQUAL_UINT64(MAX_TOKENS_PER_EXPR / 2, result);
+
+    for (size_t i = 0; i < EXPR_CONTEXT_COUNT; i++) {
+        expression_return_reference(taken[i]);
+    }
+    again = expression_take_reference();
+    TEST_ASSERT_EQUAL_PTR(taken[0], again);
+    expression_return_reference(again);
+}
+
+// Writes "1 + 1 + ... + 1" with the given odd number of tokens to buff.
+static char *
+ones(char *buff, size_t tokens) {
+    char *end = buff;
+    for (size_t i = 0; i < tokens; i++) {
+        *end++ = i % 2 == 0 ? '1' : '+';
+    }
+    *end = '\0';
+    return buff;
+}
+
+void arena_capacity() {
+    static uint8_t arena[EXPR_ARENA_SIZE(8)];
+    static char str[64];
+    uint64_t result;
+
+    // Test an arena holds at least the tokens it was sized for, and no more
+    // than fit in it.
+    expression_init(&g_expr, arena, sizeof(arena));
+    size_t capacity = 0;
+    while (capacity % 2 == 0 ? expression_append_int(&g_expr, 1) : expression_append_operator(&g_expr, TOK_PLUS)) {
+        capacity += 1;
+    }
+    TEST_ASSERT_TRUE(capacity >= 8);
+    TEST_ASSERT_TRUE(capacity <= sizeof(arena) / TOK_BYTES_PER_TOKEN);
+    TEST_ASSERT_EQUAL_size_t(capacity, g_expr.size);
+
+    // Test parsing into a full arena fails, and a reset makes room again.
+    size_t fits = capacity % 2 == 0 ? capacity - 1 : capacity;
+    TEST_ASSERT_EQUAL(MATH_ERR_OUT_OF_TOKENS, expression_set_from_str(&g_expr, ones(str, fits + 2)));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, ones(str, fits)));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(&g_expr, &result));
+    TEST_ASSERT_EQUAL_UINT64(fits / 2 + 1, result);
+
+    // Test typing into a full arena fails without changing anything, though
+    // the last literal can still be extended.
+    if (fits < capacity) {
+        TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_PLUS));
+    }
+    TEST_ASSERT_EQUAL(MATH_ERR_OUT_OF_TOKENS, expression_feed_char(&g_expr, '('));
+    TEST_ASSERT_EQUAL_size_t(capacity, g_expr.size);
+    if (fits == capacity) {
+        type(&g_expr, "1");
+        check_same_as_parsed(&g_expr, strcat(ones(str, fits), "1"));
+    }
+
+    // Test an arena too small for a single token.
+    static uint8_t tiny[4];
+    expression_init(&g_expr, tiny, sizeof(tiny));
+    TEST_ASSERT_FALSE(expression_append_int(&g_expr, 1));
+    TEST_ASSERT_EQUAL(MATH_ERR_OUT_OF_TOKENS, expression_set_from_str(&g_expr, "1"));
+}
+
+void growable_chunks() {
+    static char str[512];
+    uint64_t result;
+
+    // Test growing a chunk at a time, with chunks which do not divide the
+    // number of tokens.
+    expression_init_growable(&g_expr, 5);
+    for (size_t i = 0; i < 201; i++) {
+        TEST_ASSERT_TRUE(i % 2 == 0 ? expression_append_int(&g_expr, 1) : expression_append_operator(&g_expr, TOK_PLUS));
+    }
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(&g_expr, &result));
+    TEST_ASSERT_EQUAL_UINT64(101, result);
+
+    // Test resetting keeps the chunks, which parsing then reuses.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "6 * 7"));
+    check_same_as_parsed(&g_expr, "6 * 7");
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, ones(str, 151)));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_evaluate(&g_expr, &result));
+    TEST_ASSERT_EQUAL_UINT64(76, result);
+
+#ifdef EXPR_COMPACT_TOKENS
+    // Test growth stops at the number of tokens a TokRef can address, and
+    // nothing more can be typed after it.
+    expression_free(&g_expr);
+    expression_init_growable(&g_expr, 256);
+    size_t count = 0;
+    while (expression_append_int(&g_expr, 1)) {
+        count += 1;
+    }
+    TEST_ASSERT_EQUAL_size_t(TOK_NIL, count);
+    TEST_ASSERT_EQUAL_size_t(TOK_NIL, g_expr.size);
+    TEST_ASSERT_FALSE(expression_append_operator(&g_expr, TOK_PLUS));
+    TEST_ASSERT_EQUAL(MATH_ERR_OUT_OF_TOKENS, expression_feed_char(&g_expr, '+'));
+    TEST_ASSERT_EQUAL_size_t(TOK_NIL, g_expr.size);
+#endif
+
+    // Test a freed expression can grow again, even a token at a time.
+    expression_free(&g_expr);
+    expression_init_growable(&g_expr, 1);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "(1 + 2) * 3"));
+    check_same_as_parsed(&g_expr, "(1 + 2) * 3");
+    expression_free(&g_expr);
+}
+
+void free_slot_reuse() {
+    static uint8_t arena[EXPR_ARENA_SIZE(16)];
+    expression_init(&g_expr, arena, sizeof(arena));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "1 + 2 * 3 - 4 / 5 % 6 ^ 7 | 9"));
+    size_t used = g_expr.tok_pool.used;
+
+    // Test removed slots are reused, so a nearly full arena can be edited
+    // without end.
+    for (int i = 0; i < 1000; i++) {
+        int pos = (i * 4) % 16;
+        TEST_ASSERT_TRUE(expression_remove(&g_expr, pos + 1));
+        TEST_ASSERT_TRUE(expression_remove(&g_expr, pos));
+        TEST_ASSERT_TRUE(expression_append_operator(&g_expr, i % 2 == 0 ? TOK_PLUS : TOK_TIMES));
+        TEST_ASSERT_TRUE(expression_append_int(&g_expr, (uint64_t)i % 10));
+    }
+    TEST_ASSERT_EQUAL_size_t(used, g_expr.tok_pool.used);
+    check_same_as_parsed(&g_expr, "3 + 7 + 1 + 2 * 5 + 6 * 8 * 9");
+
+    // Test compacting keeps the order and values of the tokens, packed into the
+    // front of the pool, and leaves the expression editable.
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 0));
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 0));
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 4));
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 4));
+    expression_compact(&g_expr);
+    TEST_ASSERT_EQUAL_size_t(g_expr.size, g_expr.tok_pool.used);
+    check_same_as_parsed(&g_expr, "7 + 1 + 5 + 6 * 8 * 9");
+    TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_MINUS));
+    TEST_ASSERT_TRUE(expression_append_int(&g_expr, 5));
+    TEST_ASSERT_EQUAL_size_t(g_expr.size, g_expr.tok_pool.used);
+    check_same_as_parsed(&g_expr, "7 + 1 + 5 + 6 * 8 * 9 - 5");
+}
+
+void groups_after_edits() {
+    // Test removed parenthesis leave slots which are not taken for them.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "1 + 2 + 3 + 4 + 5 + 6 + 7 + (8 + 9) * 10"));
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 18));
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, 14));
+#ifdef EXPR_COMPACT_TOKENS
+    TEST_ASSERT_TRUE(g_expr.tok_pool.in_order);
+#endif
+    check_same_as_parsed(&g_expr, "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 * 10");
+
+    // Test parenthesis appended into the freed slots, and so out of list
+    // order, are matched by following the list.
+    TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_PLUS));
+    TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_LEFT_PARENTHESIS));
+    TEST_ASSERT_TRUE(expression_append_int(&g_expr, 1));
+    TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_PLUS));
+    TEST_ASSERT_TRUE(expression_append_int(&g_expr, 2));
+    TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_RIGHT_PARENTHESIS));
+#ifdef EXPR_COMPACT_TOKENS
+    TEST_ASSERT_FALSE(g_expr.tok_pool.in_order);
+#endif
+    check_same_as_parsed(&g_expr, "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 * 10 + (1 + 2)");
+    TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_RIGHT_PARENTHESIS));
+    check_same_as_parsed(&g_expr, "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 * 10 + (1 + 2))");
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, (int)g_expr.size - 1));
+
+    // Test compacting puts the slots back in list order.
+    expression_compact(&g_expr);
+#ifdef EXPR_COMPACT_TOKENS
+    TEST_ASSERT_TRUE(g_expr.tok_pool.in_order);
+#endif
+    check_same_as_parsed(&g_expr, "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 * 10 + (1 + 2)");
+
+    // Test parenthesis inserted in the middle of the list are matched in list
+    // order rather than slot order.
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_LEFT_PARENTHESIS, 0));
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_RIGHT_PARENTHESIS, 4));
+#ifdef EXPR_COMPACT_TOKENS
+    TEST_ASSERT_FALSE(g_expr.tok_pool.in_order);
+#endif
+    check_same_as_parsed(&g_expr, "(1 + 2) + 3 + 4 + 5 + 6 + 7 + 8 + 9 * 10 + (1 + 2)");
+    TEST_ASSERT_TRUE(expression_insert_operator(&g_expr, TOK_RIGHT_PARENTHESIS, 0));
+    check_same_as_parsed(&g_expr, ") (1 + 2) + 3 + 4 + 5 + 6 + 7 + 8 + 9 * 10 + (1 + 2)");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(precedence);
+    RUN_TEST(associativity);
+    RUN_TEST(unary_chains);
+    RUN_TEST(empty_groups);
+    RUN_TEST(unmatched_parenthesis);
+    RUN_TEST(long_groups);
+    RUN_TEST(malformed);
+    RUN_TEST(bounded_text);
+    RUN_TEST(division_by_zero);
+    RUN_TEST(wide_shifts);
+    RUN_TEST(sized_matches_full_width);
+    RUN_TEST(typing_matches_parsing);
+    RUN_TEST(literal_extension);
+    RUN_TEST(backspace_matches_parsing);
+    RUN_TEST(cursor_edits);
+    RUN_TEST(cached_values_follow_edits);
+    RUN_TEST(preview_incomplete);
+    RUN_TEST(preview_while_typing);
+    RUN_TEST(preview_after_edits);
+    RUN_TEST(context_pool);
+    RUN_TEST(arena_capacity);
+    RUN_TEST(growable_chunks);
+    RUN_TEST(free_slot_reuse);
+    RUN_TEST(groups_after_edits);
+
+    return UNITY_END();
+}
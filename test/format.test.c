@@ -0,0 +1,70 @@
+// Formatter tests.
+
+#include "unity.h"
+#include "format.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const char *
+format(uint64_t value, FormatBase base, uint8_t group, char separator, bool prefix) {
+    static char buff[FORMAT_BUFF_SIZE];
+    FormatSpec spec = {base, group, separator, prefix};
+    format_uint(value, &spec, buff, sizeof(buff));
+    return buff;
+}
+
+void decimal_format() {
+    // Test zero and the largest value in each width the digits pass through.
+    TEST_ASSERT_EQUAL_STRING("0", format(0, FORMAT_BASE_DEC, 0, 0, false));
+    TEST_ASSERT_EQUAL_STRING("65535", format(UINT16_MAX, FORMAT_BASE_DEC, 0, 0, false));
+    TEST_ASSERT_EQUAL_STRING("4294967295", format(UINT32_MAX, FORMAT_BASE_DEC, 0, 0, false));
+    TEST_ASSERT_EQUAL_STRING("18446744073709551615", format(UINT64_MAX, FORMAT_BASE_DEC, 0, 0, false));
+
+    // Test values just past each width.
+    TEST_ASSERT_EQUAL_STRING("65536", format(65536, FORMAT_BASE_DEC, 0, 0, false));
+    TEST_ASSERT_EQUAL_STRING("4294967296", format(4294967296, FORMAT_BASE_DEC, 0, 0, false));
+
+    // Test grouping, with and without a short leading group.
+    TEST_ASSERT_EQUAL_STRING("16,000,000", format(16000000, FORMAT_BASE_DEC, 3, ',', false));
+    TEST_ASSERT_EQUAL_STRING("999,999", format(999999, FORMAT_BASE_DEC, 3, ',', false));
+    TEST_ASSERT_EQUAL_STRING("999", format(999, FORMAT_BASE_DEC, 3, ',', false));
+}
+
+void power_of_two_format() {
+    // Test zero in every base.
+    TEST_ASSERT_EQUAL_STRING("0x0", format(0, FORMAT_BASE_HEX, 0, 0, true));
+    TEST_ASSERT_EQUAL_STRING("0", format(0, FORMAT_BASE_OCT, 0, 0, true));
+    TEST_ASSERT_EQUAL_STRING("0b0", format(0, FORMAT_BASE_BIN, 0, 0, true));
+
+    // Test digits spanning several bytes.
+    TEST_ASSERT_EQUAL_STRING("DEADBEEF", format(0xDEADBEEF, FORMAT_BASE_HEX, 0, 0, false));
+    TEST_ASSERT_EQUAL_STRING("0x100", format(0x100, FORMAT_BASE_HEX, 0, 0, true));
+    TEST_ASSERT_EQUAL_STRING("0b100000000", format(0x100, FORMAT_BASE_BIN, 0, 0, true));
+    TEST_ASSERT_EQUAL_STRING("01777777777777777777777", format(UINT64_MAX, FORMAT_BASE_OCT, 0, 0, true));
+    TEST_ASSERT_EQUAL_STRING("0xFFFF_FFFF_FFFF_FFFF", format(UINT64_MAX, FORMAT_BASE_HEX, 4, '_', true));
+
+    // Test grouping with a short leading group.
+    TEST_ASSERT_EQUAL_STRING("0b10_1010_0101", format(0x2A5, FORMAT_BASE_BIN, 4, '_', true));
+}
+
+void buffer_too_small() {
+    FormatSpec spec = {FORMAT_BASE_DEC, 0, 0, false};
+    char buff[4] = "abc";
+
+    // Test the null terminator must fit as well.
+    TEST_ASSERT_EQUAL_size_t(0, format_uint(1234, &spec, buff, sizeof(buff)));
+    TEST_ASSERT_EQUAL_STRING("abc", buff);
+    TEST_ASSERT_EQUAL_size_t(3, format_uint(123, &spec, buff, sizeof(buff)));
+    TEST_ASSERT_EQUAL_STRING("123", buff);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(decimal_format);
+    RUN_TEST(power_of_two_format);
+    RUN_TEST(buffer_too_small);
+
+    return UNITY_END();
+}
@@ -0,0 +1,85 @@
+// Image tests.
+
+#include "unity.h"
+#include "bytecode.h"
+#include "expression.h"
+#include "image.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint8_t g_code_buff[BYTECODE_SIZE(MAX_TOKENS_PER_EXPR)];
+static uint8_t g_image[IMAGE_SIZE(MAX_TOKENS_PER_EXPR)];
+
+// Compiles and saves str, returning the length of its image.
+static size_t
+save(const char *str) {
+    Expression *expr = expression_take_reference();
+    Bytecode code;
+    bytecode_init(&code, g_code_buff, sizeof(g_code_buff));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(expr, str));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_compile(expr, &code));
+    expression_return_reference(expr);
+
+    size_t size = 0;
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, image_save(&code, g_image, sizeof(g_image), &size));
+    return size;
+}
+
+void round_trip() {
+    ExprImage image;
+    uint64_t result;
+
+    // Test literals packed in the opcode, and in varints of every length.
+    save("(127 + 128) * 0xFFFFFFFFFFFFFFFF - ~16383 / 16384");
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, image_load(&image, g_image, sizeof(g_image), IMAGE_SPACE_RAM));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, image_run(&image, &result));
+    TEST_ASSERT_EQUAL_UINT64((127 + 128) * UINT64_MAX - ~(uint64_t)16383 / 16384, result);
+
+    // Test errors are the same as for the program the image was saved from.
+    save("1 / (2 - 2)");
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, image_load(&image, g_image, sizeof(g_image), IMAGE_SPACE_RAM));
+    TEST_ASSERT_EQUAL(MATH_ERR_DIV_BY_ZERO, image_run(&image, &result));
+}
+
+void packed_size() {
+    // Test the header, and one byte per small literal or operator.
+    TEST_ASSERT_EQUAL_size_t(5 + 3, save("1 + 2"));
+    TEST_ASSERT_EQUAL_UINT8('E', g_image[0]);
+    TEST_ASSERT_EQUAL_UINT8('X', g_image[1]);
+    TEST_ASSERT_EQUAL_UINT8(IMAGE_VERSION, g_image[2]);
+    TEST_ASSERT_EQUAL_UINT8(2, g_image[3]);
+    TEST_ASSERT_EQUAL_UINT8(3, g_image[4]);
+
+    // Test a literal needing a two byte varint after its opcode.
+    TEST_ASSERT_EQUAL_size_t(5 + 4, save("-300"));
+}
+
+void corrupt_image() {
+    ExprImage image;
+    uint64_t result;
+    size_t size = save("1 + 2");
+
+    // Test the image must be complete.
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, image_load(&image, g_image, size - 1, IMAGE_SPACE_RAM));
+
+    // Test an unknown version is refused.
+    g_image[2] = IMAGE_VERSION + 1;
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, image_load(&image, g_image, size, IMAGE_SPACE_RAM));
+    g_image[2] = IMAGE_VERSION;
+
+    // Test an operator without enough operands fails when run.
+    g_image[5] = OPC_ADD;
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, image_load(&image, g_image, size, IMAGE_SPACE_RAM));
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, image_run(&image, &result));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(round_trip);
+    RUN_TEST(packed_size);
+    RUN_TEST(corrupt_image);
+
+    return UNITY_END();
+}
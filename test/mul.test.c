@@ -0,0 +1,83 @@
+// Multiply tests.
+
+#include "unity.h"
+#include "mul.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t values32[] = {
+    0, 1, 2, 3, 0xFF, 0x100, 0xFFFF, 0x10000, 0x12345678, 0x7FFFFFFF, 0x80000000, 0xDEADBEEF, 0xFFFFFFFF,
+};
+#define VALUES32_COUNT (sizeof(values32) / sizeof(values32[0]))
+
+void word_multiply() {
+    // Test the largest product.
+    TEST_ASSERT_EQUAL_UINT32(0xFFFE0001, mul_u16_wide(0xFFFF, 0xFFFF));
+    TEST_ASSERT_EQUAL_UINT16(0xFFFE, mul_u16_high(0xFFFF, 0xFFFF));
+
+    // Test products carrying between every pair of bytes.
+    TEST_ASSERT_EQUAL_UINT32(0x1234u * 0xABCDu, mul_u16_wide(0x1234, 0xABCD));
+    TEST_ASSERT_EQUAL_UINT32(0x00FFu * 0xFF00u, mul_u16_wide(0x00FF, 0xFF00));
+    TEST_ASSERT_EQUAL_UINT32(0x8001u * 0x8001u, mul_u16_wide(0x8001, 0x8001));
+
+    // Test multiplying by zero and one.
+    TEST_ASSERT_EQUAL_UINT32(0, mul_u16_wide(0, 0xFFFF));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFF, mul_u16_wide(1, 0xFFFF));
+}
+
+void dword_multiply() {
+    // Test every pair against the native 64 bit product.
+    for (size_t i = 0; i < VALUES32_COUNT; i++) {
+        for (size_t j = 0; j < VALUES32_COUNT; j++) {
+            uint64_t expected = (uint64_t)values32[i] * values32[j];
+            TEST_ASSERT_EQUAL_UINT64(expected, mul_u32_wide(values32[i], values32[j]));
+            TEST_ASSERT_EQUAL_UINT32((uint32_t)expected, mul_u32_low(values32[i], values32[j]));
+            TEST_ASSERT_EQUAL_UINT32((uint32_t)(expected >> 32), mul_u32_high(values32[i], values32[j]));
+        }
+    }
+}
+
+void qword_multiply() {
+    uint64_t high, low;
+
+    // Test the largest product.
+    mul_u64_wide(UINT64_MAX, UINT64_MAX, &high, &low);
+    TEST_ASSERT_EQUAL_UINT64(0xFFFFFFFFFFFFFFFE, high);
+    TEST_ASSERT_EQUAL_UINT64(1, low);
+
+    // Test a product whose middle column carries into the high half.
+    mul_u64_wide(0xFFFFFFFF00000001, 0xFFFFFFFF00000001, &high, &low);
+    TEST_ASSERT_EQUAL_UINT64(0xFFFFFFFE00000002, high);
+    TEST_ASSERT_EQUAL_UINT64(0xFFFFFFFE00000001, low);
+
+    // Test a product which fits in the low half.
+    mul_u64_wide(0xFFFFFFFF, 0xFFFFFFFF, &high, &low);
+    TEST_ASSERT_EQUAL_UINT64(0, high);
+    TEST_ASSERT_EQUAL_UINT64(0xFFFFFFFE00000001, low);
+
+    // Test the high half of a division by ten's reciprocal.
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX / 10, mul_u64_high(0xCCCCCCCCCCCCCCCD, UINT64_MAX) >> 3);
+
+    // Test truncated products against the native 64 bit multiply.
+    for (size_t i = 0; i < VALUES32_COUNT; i++) {
+        for (size_t j = 0; j < VALUES32_COUNT; j++) {
+            uint64_t lhs = ((uint64_t)values32[i] << 32) | values32[j];
+            uint64_t rhs = ((uint64_t)values32[j] << 32) | values32[VALUES32_COUNT - 1 - i];
+            TEST_ASSERT_EQUAL_UINT64(lhs * rhs, mul_u64_low(lhs, rhs));
+
+            mul_u64_wide(lhs, rhs, &high, &low);
+            TEST_ASSERT_EQUAL_UINT64(lhs * rhs, low);
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(word_multiply);
+    RUN_TEST(dword_multiply);
+    RUN_TEST(qword_multiply);
+
+    return UNITY_END();
+}
@@ -1,6 +1,8 @@
 // Number tests.
 
 #include "unity.h"
+#include "number.h"
+#include "operator.h"
 #include "token.h"
 #include "inttypes.h"
 
@@ -14,15 +16,15 @@ void unsigned_byte_arithmetic() {
     number_set_from_uint(&num250, 250);
 
     // Test basic addition.
-    number_add(&num21, &num5, &result);
+    number_add(&num21, &num5, &result, SIZE_MODE_BYTE);
     TEST_ASSERT_EQUAL_UINT8(21 + 5, VAL(&result));
 
     // Test addition resulting in an overflow.
-    number_add(&num250, &num21, &result);
+    number_add(&num250, &num21, &result, SIZE_MODE_BYTE);
     TEST_ASSERT_EQUAL_UINT8(250 + 21, VAL(&result));
 
     // Test basic subtraction.
-    number_sub(&num21, &num5, &result);
+    number_sub(&num21, &num5, &result, SIZE_MODE_BYTE);
     TEST_ASSERT_EQUAL_UINT8(21 - 5, VAL(&result));
 
     // Test subtraction resulting in an underflow.
@@ -150,12 +152,218 @@ void unsigned_qword_arithmetic() {
     TEST_ASSERT_EQUAL_UINT64(val500quad / val100tril, VAL(&result));
 }
 
+static const int64_t signed_values[] = {
+    INT64_MIN, INT64_MIN + 1, -1000000007, -32768, -129, -128, -7, -3, -1, 1, 2, 3, 7, 127, 128, 32767, 1000000007,
+    INT64_MAX,
+};
+#define SIGNED_VALUES_COUNT (sizeof(signed_values) / sizeof(signed_values[0]))
+
+// Checks number_divmod in signed mode against C on values truncated to the
+// width of mode, given the most negative value of that width.
+static void
+check_signed_divmod(SizeMode mode, int64_t min) {
+    for (size_t i = 0; i < SIGNED_VALUES_COUNT; i++) {
+        for (size_t j = 0; j < SIGNED_VALUES_COUNT; j++) {
+            // Sign extend the truncated values, as they are read in signed mode.
+            int64_t lhs = (int64_t)number_truncate((uint64_t)signed_values[i], mode);
+            int64_t rhs = (int64_t)number_truncate((uint64_t)signed_values[j], mode);
+            lhs = min != INT64_MIN && lhs >= -min ? lhs + 2 * min : lhs;
+            rhs = min != INT64_MIN && rhs >= -min ? rhs + 2 * min : rhs;
+            if (rhs == 0) {
+                continue;
+            }
+
+            // The most negative value divided by -1 wraps back around to it.
+            int64_t quotient = lhs == min && rhs == -1 ? min : lhs / rhs;
+            int64_t remainder = lhs == min && rhs == -1 ? 0 : lhs % rhs;
+
+            Token num_lhs, num_rhs, result_quotient, result_remainder;
+            number_set_from_uint(&num_lhs, (uint64_t)lhs);
+            number_set_from_uint(&num_rhs, (uint64_t)rhs);
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, number_divmod(&num_lhs, &num_rhs, &result_quotient, &result_remainder, mode,
+                                                         SIGN_MODE_SIGNED));
+            TEST_ASSERT_EQUAL_UINT64(number_truncate((uint64_t)quotient, mode), VAL(&result_quotient));
+            TEST_ASSERT_EQUAL_UINT64(number_truncate((uint64_t)remainder, mode), VAL(&result_remainder));
+        }
+    }
+}
+
+void signed_divmod() {
+    // Test truncation toward zero, and the sign of the remainder following the
+    // dividend, in every width.
+    check_signed_divmod(SIZE_MODE_BYTE, INT8_MIN);
+    check_signed_divmod(SIZE_MODE_WORD, INT16_MIN);
+    check_signed_divmod(SIZE_MODE_DWORD, INT32_MIN);
+    check_signed_divmod(SIZE_MODE_QWORD, INT64_MIN);
+
+    // Test division by zero leaves the results untouched.
+    Token num7, num0, quotient, remainder;
+    number_set_from_uint(&num7, 7);
+    number_set_from_uint(&num0, 0);
+    number_set_from_uint(&quotient, 11);
+    number_set_from_uint(&remainder, 12);
+    TEST_ASSERT_EQUAL(MATH_ERR_DIV_BY_ZERO, number_divmod(&num7, &num0, &quotient, &remainder, SIZE_MODE_QWORD,
+                                                          SIGN_MODE_SIGNED));
+    TEST_ASSERT_EQUAL_UINT64(11, VAL(&quotient));
+    TEST_ASSERT_EQUAL_UINT64(12, VAL(&remainder));
+}
+
+void unsigned_qword_divide() {
+    static const uint64_t values[] = {
+        0, 1, 2, 3, 7, 10, 0xFF, 0x100, 0xFFFFFFFF, 0x100000000, 0xDEADBEEFCAFEBABE, 0x8000000000000000,
+        0x8000000000000001, UINT64_MAX - 1, UINT64_MAX,
+    };
+
+    // Test the operator table divides the same as number_divmod, and both the
+    // same as C, whichever division NUMBER_SOFT_DIVIDE picks.
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        for (size_t j = 1; j < sizeof(values) / sizeof(values[0]); j++) {
+            Token num_lhs, num_rhs, quotient, remainder;
+            number_set_from_uint(&num_lhs, values[i]);
+            number_set_from_uint(&num_rhs, values[j]);
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, number_divmod(&num_lhs, &num_rhs, &quotient, &remainder, SIZE_MODE_QWORD,
+                                                         SIGN_MODE_UNSIGNED));
+            TEST_ASSERT_EQUAL_UINT64(values[i] / values[j], VAL(&quotient));
+            TEST_ASSERT_EQUAL_UINT64(values[i] % values[j], VAL(&remainder));
+
+            uint64_t result;
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, operation_divide(values[i], values[j], &result));
+            TEST_ASSERT_EQUAL_UINT64(values[i] / values[j], result);
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, operation_modulo(values[i], values[j], &result));
+            TEST_ASSERT_EQUAL_UINT64(values[i] % values[j], result);
+        }
+    }
+
+    uint64_t result;
+    TEST_ASSERT_EQUAL(MATH_ERR_DIV_BY_ZERO, operation_divide(1, 0, &result));
+    TEST_ASSERT_EQUAL(MATH_ERR_DIV_BY_ZERO, operation_modulo(1, 0, &result));
+}
+
+static const uint64_t flag_values[] = {
+    0, 1, 2, 3, 0x7F, 0x80, 0xFF, 0x7FFF, 0x8000, 0xFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0x5555555555555555,
+    0xDEADBEEFCAFEBABE, 0x7FFFFFFFFFFFFFFF, 0x8000000000000000, UINT64_MAX,
+};
+#define FLAG_VALUES_COUNT (sizeof(flag_values) / sizeof(flag_values[0]))
+
+// Reads value, already truncated to a width with the given sign bit, as signed.
+static __int128
+sign_extend(uint64_t value, uint64_t sign_bit) {
+    return (value & sign_bit) != 0 ? (__int128)value - 2 * (__int128)sign_bit : (__int128)value;
+}
+
+// Works out the result and flags of lhs type rhs in 128 bits, for comparison.
+static uint8_t
+expected_flags(TokenType type, uint64_t lhs, uint64_t rhs, SizeMode mode, uint64_t *value) {
+    uint64_t max = number_truncate(UINT64_MAX, mode);
+    uint64_t sign_bit = (max >> 1) + 1;
+    __int128 slhs = sign_extend(lhs, sign_bit);
+    __int128 srhs = sign_extend(rhs, sign_bit);
+    unsigned __int128 wide;
+    __int128 signed_wide;
+    bool carry;
+
+    switch (type) {
+        case TOK_PLUS:
+            wide = (unsigned __int128)lhs + rhs;
+            signed_wide = slhs + srhs;
+            carry = wide > max;
+            break;
+        case TOK_MINUS:
+            wide = (unsigned __int128)lhs - rhs;
+            signed_wide = slhs - srhs;
+            carry = lhs < rhs;
+            break;
+        default:
+            wide = (unsigned __int128)lhs * rhs;
+            signed_wide = slhs * srhs;
+            carry = wide > max;
+            break;
+    }
+
+    *value = (uint64_t)wide & max;
+    uint8_t flags = 0;
+    if (carry) {
+        flags |= NUMBER_FLAG_CARRY;
+    }
+    if (*value == 0) {
+        flags |= NUMBER_FLAG_ZERO;
+    }
+    if ((*value & sign_bit) != 0) {
+        flags |= NUMBER_FLAG_NEGATIVE;
+    }
+    if (signed_wide < -(__int128)sign_bit || signed_wide >= (__int128)sign_bit) {
+        flags |= NUMBER_FLAG_OVERFLOW;
+    }
+    return flags;
+}
+
+void status_flags() {
+    static const TokenType types[] = {TOK_PLUS, TOK_MINUS, TOK_TIMES};
+
+    // Test the flags of add, sub and mul against wide arithmetic, in every
+    // width and both sign modes, which only differ for division and shifts.
+    for (SizeMode mode = SIZE_MODE_BYTE; mode <= SIZE_MODE_QWORD; mode++) {
+        for (SignMode sign = SIGN_MODE_UNSIGNED; sign <= SIGN_MODE_SIGNED; sign++) {
+            for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+                for (size_t i = 0; i < FLAG_VALUES_COUNT; i++) {
+                    for (size_t j = 0; j < FLAG_VALUES_COUNT; j++) {
+                        uint64_t lhs = number_truncate(flag_values[i], mode);
+                        uint64_t rhs = number_truncate(flag_values[j], mode);
+                        uint64_t value;
+                        uint8_t expected = expected_flags(types[t], lhs, rhs, mode, &value);
+
+                        Token num_lhs, num_rhs, result;
+                        uint8_t flags = 0xFF;
+                        number_set_from_uint(&num_lhs, lhs);
+                        number_set_from_uint(&num_rhs, rhs);
+                        TEST_ASSERT_EQUAL(MATH_ERR_OK,
+                                          number_apply(types[t], &num_lhs, &num_rhs, &result, mode, sign, &flags));
+                        TEST_ASSERT_EQUAL_UINT64(value, VAL(&result));
+                        TEST_ASSERT_EQUAL_HEX8(expected, flags);
+                    }
+                }
+            }
+        }
+    }
+
+    // Test a few by hand, in bytes.
+    const struct {
+        TokenType type;
+        uint64_t lhs, rhs;
+        uint8_t flags;
+    } cases[] = {
+        {TOK_PLUS, 0x7F, 1, NUMBER_FLAG_NEGATIVE | NUMBER_FLAG_OVERFLOW},
+        {TOK_PLUS, 0xFF, 1, NUMBER_FLAG_CARRY | NUMBER_FLAG_ZERO},
+        {TOK_PLUS, 0x80, 0x80, NUMBER_FLAG_CARRY | NUMBER_FLAG_ZERO | NUMBER_FLAG_OVERFLOW},
+        {TOK_MINUS, 0, 1, NUMBER_FLAG_CARRY | NUMBER_FLAG_NEGATIVE},
+        {TOK_MINUS, 0x80, 1, NUMBER_FLAG_OVERFLOW},
+        {TOK_MINUS, 5, 5, NUMBER_FLAG_ZERO},
+        {TOK_TIMES, 0x80, 2, NUMBER_FLAG_CARRY | NUMBER_FLAG_ZERO | NUMBER_FLAG_OVERFLOW},
+        {TOK_TIMES, 0xFF, 0xFF, NUMBER_FLAG_CARRY},
+        {TOK_TIMES, 0x40, 2, NUMBER_FLAG_NEGATIVE | NUMBER_FLAG_OVERFLOW},
+        {TOK_TIMES, 0xFF, 0x80, NUMBER_FLAG_CARRY | NUMBER_FLAG_NEGATIVE | NUMBER_FLAG_OVERFLOW},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Token num_lhs, num_rhs, result;
+        uint8_t flags;
+        number_set_from_uint(&num_lhs, cases[i].lhs);
+        number_set_from_uint(&num_rhs, cases[i].rhs);
+        TEST_ASSERT_EQUAL(MATH_ERR_OK,
+                          number_apply(cases[i].type, &num_lhs, &num_rhs, &result, SIZE_MODE_BYTE, SIGN_MODE_SIGNED,
+                                       &flags));
+        TEST_ASSERT_EQUAL_HEX8(cases[i].flags, flags);
+    }
+}
+
 int main() {
     UNITY_BEGIN();
     RUN_TEST(unsigned_byte_arithmetic);
     RUN_TEST(unsigned_word_arithmetic);
     RUN_TEST(unsigned_dword_arithmetic);
     RUN_TEST(unsigned_qword_arithmetic);
+    RUN_TEST(signed_divmod);
+    RUN_TEST(unsigned_qword_divide);
+    RUN_TEST(status_flags);
 
     return UNITY_END();
 }
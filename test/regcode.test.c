@@ -0,0 +1,112 @@
+// Register VM tests.
+
+#include "unity.h"
+#include "expression.h"
+#include "operator.h"
+#include "regcode.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint8_t g_arena[EXPR_ARENA_SIZE(MAX_TOKENS_PER_EXPR)];
+static RegInstr g_code_buff[REGCODE_SIZE(MAX_TOKENS_PER_EXPR)];
+static Expression g_expr;
+static RegCode g_code;
+
+// Compiles lhs op rhs, with both operands as literals.
+static void
+compile_binary(uint64_t lhs, TokenType op, uint64_t rhs) {
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    regcode_init(&g_code, g_code_buff, REGCODE_SIZE(MAX_TOKENS_PER_EXPR));
+    TEST_ASSERT_TRUE(expression_append_int(&g_expr, lhs));
+    TEST_ASSERT_TRUE(expression_append_operator(&g_expr, op));
+    TEST_ASSERT_TRUE(expression_append_int(&g_expr, rhs));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_compile_regcode(&g_expr, &g_code));
+}
+
+// Opcode of the instruction after the load of the left operand.
+static RegOpcode
+fused_opcode() {
+    return (RegOpcode)g_code.code[1].opcode;
+}
+
+void wide_shift_immediates() {
+    static const uint64_t counts[] = {63, 64, 65, 200, 7351, UINT64_MAX};
+    uint64_t result;
+
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        uint64_t expected = counts[i] < 64 ? (uint64_t)1 << 63 : 0;
+
+        // Test the count is fused into the shift, and every bit is shifted out
+        // once it reaches the width.
+        compile_binary(1, TOK_BITWISE_LEFT_SHIFT, counts[i]);
+        TEST_ASSERT_EQUAL(ROP_SHL_IMM, fused_opcode());
+        TEST_ASSERT_EQUAL(MATH_ERR_OK, regcode_run(&g_code, &result));
+        TEST_ASSERT_EQUAL_UINT64(expected, result);
+
+        compile_binary((uint64_t)1 << 63, TOK_BITWISE_RIGHT_SHIFT, counts[i]);
+        TEST_ASSERT_EQUAL(ROP_SHR_IMM, fused_opcode());
+        TEST_ASSERT_EQUAL(MATH_ERR_OK, regcode_run(&g_code, &result));
+        TEST_ASSERT_EQUAL_UINT64(counts[i] < 64 ? 1 : 0, result);
+    }
+
+    // Test the register forms the same way.
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_set_from_str(&g_expr, "1 << (60 + 4) | 1 >> (100 - 1)"));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, expression_compile_regcode(&g_expr, &g_code));
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, regcode_run(&g_code, &result));
+    TEST_ASSERT_EQUAL_UINT64(0, result);
+}
+
+void divide_by_literal() {
+    static const uint64_t dividends[] = {
+        0, 1, 2, 3, 6, 7, 8, 1000, 0xDEADBEEFCAFEBABE, 0x7FFFFFFFFFFFFFFF, 0x8000000000000000,
+        0x8000000000000001, UINT64_MAX - 1, UINT64_MAX,
+    };
+    static const uint64_t divisors[] = {
+        1, 2, 3, 7, 10, 16, (uint64_t)1 << 32, (uint64_t)1 << 63, 0x8000000000000001, UINT64_MAX - 1, UINT64_MAX,
+    };
+
+    for (size_t i = 0; i < sizeof(divisors) / sizeof(divisors[0]); i++) {
+        uint64_t divisor = divisors[i];
+        bool power_of_two = (divisor & (divisor - 1)) == 0;
+        for (size_t j = 0; j < sizeof(dividends) / sizeof(dividends[0]); j++) {
+            uint64_t expected, result;
+
+            // Test division rewritten as a shift, or a multiply by the
+            // reciprocal, matches dividing.
+            compile_binary(dividends[j], TOK_DIVIDED_BY, divisor);
+            if (divisor > 1) {
+                TEST_ASSERT_EQUAL(power_of_two ? ROP_SHR_IMM : ROP_DIV_MAGIC, fused_opcode());
+            }
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, operation_divide(dividends[j], divisor, &expected));
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, regcode_run(&g_code, &result));
+            TEST_ASSERT_EQUAL_UINT64(expected, result);
+
+            // Test modulo rewritten as a mask, or from the quotient.
+            compile_binary(dividends[j], TOK_MODULO, divisor);
+            if (divisor > 1) {
+                TEST_ASSERT_EQUAL(power_of_two ? ROP_AND_IMM : ROP_MOD_MAGIC, fused_opcode());
+            }
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, operation_modulo(dividends[j], divisor, &expected));
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, regcode_run(&g_code, &result));
+            TEST_ASSERT_EQUAL_UINT64(expected, result);
+        }
+    }
+
+    // Test dividing by a literal zero still fails when run.
+    uint64_t result;
+    compile_binary(5, TOK_DIVIDED_BY, 0);
+    TEST_ASSERT_EQUAL(MATH_ERR_DIV_BY_ZERO, regcode_run(&g_code, &result));
+    compile_binary(5, TOK_MODULO, 0);
+    TEST_ASSERT_EQUAL(MATH_ERR_DIV_BY_ZERO, regcode_run(&g_code, &result));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(wide_shift_immediates);
+    RUN_TEST(divide_by_literal);
+
+    return UNITY_END();
+}
@@ -0,0 +1,181 @@
+// Single pass evaluator tests.
+
+#include "unity.h"
+#include "expression.h"
+#include "shunt.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+#define RANDOM_CASES 20000
+#define RANDOM_MAX_TOKENS 14
+
+static uint8_t g_arena[EXPR_ARENA_SIZE(2 * EXPR_SHUNT_DEPTH + 8)];
+static Expression g_expr;
+
+// Evaluates the tokens of g_expr through the tree.
+static MathErr
+tree_evaluate(uint64_t *result) {
+#ifdef EXPR_SHUNTING_YARD
+    // expression_evaluate is the single pass evaluator in this build, so the
+    // tree is walked by the number layer instead.
+    return expression_evaluate_sized(&g_expr, SIZE_MODE_QWORD, result);
+#else
+    return expression_evaluate(&g_expr, result);
+#endif
+}
+
+// Evaluates the tokens of g_expr in a single pass.
+static MathErr
+shunt_evaluate(uint64_t *result) {
+    Shunt shunt;
+    shunt_init(&shunt);
+    for (TokRef tok = g_expr.start; tok != TOK_NIL; tok = tok_next(&g_expr.tok_pool, tok)) {
+        MathErr err = shunt_push(&shunt, tok_type(&g_expr.tok_pool, tok), tok_value(&g_expr.tok_pool, tok));
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+    }
+    return shunt_finish(&shunt, result);
+}
+
+// Checks both evaluators give the same result or error for str, and that it is
+// expected.
+static void
+check_same(const char *str, MathErr expected) {
+    uint64_t tree_result = 0, shunt_result = 0;
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, expression_set_from_str(&g_expr, str), str);
+    TEST_ASSERT_EQUAL_MESSAGE(expected, tree_evaluate(&tree_result), str);
+    TEST_ASSERT_EQUAL_MESSAGE(expected, shunt_evaluate(&shunt_result), str);
+    if (expected == MATH_ERR_OK) {
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(tree_result, shunt_result, str);
+    }
+}
+
+void error_precedence() {
+    // Test a mismatched parenthesis beats a division by zero.
+    check_same("1 / 0 + (", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_same("(1 / 0", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_same("1 + ) (", MATH_ERR_PARENTHESIS_MISMATCH);
+
+    // Test a mismatch beats a badly formed group anywhere but before it.
+    check_same("(1 2", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_same("1 2 )", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_same(") 1 2", MATH_ERR_PARENTHESIS_MISMATCH);
+    check_same("(1 2) + (", MATH_ERR_MALFORMED_EXPR);
+    check_same("((1 +) 2", MATH_ERR_MALFORMED_EXPR);
+
+    // Test a badly formed expression beats a division by zero.
+    check_same("1 / 0 2", MATH_ERR_MALFORMED_EXPR);
+    check_same("1 (2) 3", MATH_ERR_MALFORMED_EXPR);
+    check_same("1 % 0 +", MATH_ERR_MALFORMED_EXPR);
+
+    // Test the division by zero found first is the one reported.
+    check_same("1 / 0 + 1 % 0", MATH_ERR_DIV_BY_ZERO);
+    check_same("(2 - 2) / (1 % 0)", MATH_ERR_DIV_BY_ZERO);
+}
+
+// xorshift, so every run checks the same cases.
+static uint32_t
+next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+void random_tokens() {
+    static const uint64_t literals[] = {0, 1, 2, 3, 7, 63, 64, 0x8000000000000000, UINT64_MAX};
+    uint32_t state = 2463534242;
+
+    // Test random token sequences, mostly badly formed, give the same result
+    // or error from both evaluators.
+    for (uint32_t i = 0; i < RANDOM_CASES; i++) {
+        expression_init(&g_expr, g_arena, sizeof(g_arena));
+        uint32_t count = 1 + next_random(&state) % RANDOM_MAX_TOKENS;
+        for (uint32_t j = 0; j < count; j++) {
+            uint32_t pick = next_random(&state) % (TOK_TYPE_COUNT + 4);
+            if (pick >= TOK_INTEGER) {
+                uint64_t value = literals[next_random(&state) % (sizeof(literals) / sizeof(literals[0]))];
+                TEST_ASSERT_TRUE(expression_append_int(&g_expr, value));
+            } else {
+                TEST_ASSERT_TRUE(expression_append_operator(&g_expr, (TokenType)pick));
+            }
+        }
+
+        uint64_t tree_result = 0, shunt_result = 0;
+        MathErr tree_err = tree_evaluate(&tree_result);
+        TEST_ASSERT_EQUAL(tree_err, shunt_evaluate(&shunt_result));
+        if (tree_err == MATH_ERR_OK) {
+            TEST_ASSERT_EQUAL_UINT64(tree_result, shunt_result);
+        }
+    }
+}
+
+// Sets g_expr to 5 inside depth pairs of parenthesis.
+static void
+build_nested(int depth) {
+    expression_init(&g_expr, g_arena, sizeof(g_arena));
+    for (int i = 0; i < depth; i++) {
+        TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_LEFT_PARENTHESIS));
+    }
+    TEST_ASSERT_TRUE(expression_append_int(&g_expr, 5));
+    for (int i = 0; i < depth; i++) {
+        TEST_ASSERT_TRUE(expression_append_operator(&g_expr, TOK_RIGHT_PARENTHESIS));
+    }
+}
+
+void nesting_depth() {
+    uint64_t result;
+
+    // Test nesting as deep as the stacks go still agrees with the tree.
+    build_nested(EXPR_SHUNT_DEPTH);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, shunt_evaluate(&result));
+    TEST_ASSERT_EQUAL_UINT64(5, result);
+
+    // Test one level more overflows, though the tree can evaluate it.
+    build_nested(EXPR_SHUNT_DEPTH + 1);
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, tree_evaluate(&result));
+    TEST_ASSERT_EQUAL(MATH_ERR_STACK_OVERFLOW, shunt_evaluate(&result));
+
+    // Test the overflow is reported as soon as it happens, so it beats a
+    // mismatch which is only known at the end.
+    TEST_ASSERT_TRUE(expression_remove(&g_expr, (int)g_expr.size - 1));
+    TEST_ASSERT_EQUAL(MATH_ERR_STACK_OVERFLOW, shunt_evaluate(&result));
+
+    // Test values waiting on open groups overflow their own stack, IE
+    // 1 + (1 + (1 + ... needs one more value than it has groups.
+    for (int depth = EXPR_SHUNT_DEPTH - 1; depth <= EXPR_SHUNT_DEPTH; depth++) {
+        Shunt shunt;
+        shunt_init(&shunt);
+        MathErr err = MATH_ERR_OK;
+        for (int i = 0; i < depth && err == MATH_ERR_OK; i++) {
+            err = shunt_push(&shunt, TOK_INTEGER, 1);
+            err = err == MATH_ERR_OK ? shunt_push(&shunt, TOK_PLUS, 0) : err;
+            err = err == MATH_ERR_OK ? shunt_push(&shunt, TOK_LEFT_PARENTHESIS, 0) : err;
+        }
+        err = err == MATH_ERR_OK ? shunt_push(&shunt, TOK_INTEGER, 1) : err;
+        for (int i = 0; i < depth && err == MATH_ERR_OK; i++) {
+            err = shunt_push(&shunt, TOK_RIGHT_PARENTHESIS, 0);
+        }
+        err = err == MATH_ERR_OK ? shunt_finish(&shunt, &result) : err;
+
+        if (depth < EXPR_SHUNT_DEPTH) {
+            TEST_ASSERT_EQUAL(MATH_ERR_OK, err);
+            TEST_ASSERT_EQUAL_UINT64(depth + 1, result);
+        } else {
+            TEST_ASSERT_EQUAL(MATH_ERR_STACK_OVERFLOW, err);
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(error_precedence);
+    RUN_TEST(random_tokens);
+    RUN_TEST(nesting_depth);
+
+    return UNITY_END();
+}
@@ -0,0 +1,147 @@
+// Output sink tests.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+#include "sink.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Where the callback of a sink writes to, taking at most accept writes.
+typedef struct Output {
+    char data[256];
+    size_t len;
+    int writes;
+    int accept;
+} Output;
+
+static bool
+output_write(void *context, const char *data, size_t len) {
+    Output *out = context;
+    if (out->writes == out->accept) {
+        return false;
+    }
+
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+    out->data[out->len] = '\0';
+    out->writes += 1;
+    return true;
+}
+
+static const FormatSpec g_grouped = {FORMAT_BASE_DEC, 3, ',', false};
+
+void memory_truncation() {
+    char buff[8];
+    Sink sink;
+
+    // Test a buffer can be filled exactly, leaving room for the terminator.
+    sink_init(&sink, buff, sizeof(buff), NULL, NULL);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "abc"));
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "defg"));
+    TEST_ASSERT_TRUE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("abcdefg", buff);
+
+    // Test output past the end is cut short, and the sink stays failed.
+    sink_init(&sink, buff, sizeof(buff), NULL, NULL);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "abc"));
+    TEST_ASSERT_FALSE(sink_write_str(&sink, "defgh"));
+    TEST_ASSERT_FALSE(sink_put(&sink, 'i'));
+    TEST_ASSERT_FALSE(sink_write_str(&sink, ""));
+    TEST_ASSERT_FALSE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("abcdefg", buff);
+
+    // Test single characters the same way.
+    sink_init(&sink, buff, sizeof(buff), NULL, NULL);
+    for (int i = 0; i < 7; i++) {
+        TEST_ASSERT_TRUE(sink_put(&sink, (char)('0' + i)));
+    }
+    TEST_ASSERT_FALSE(sink_put(&sink, '7'));
+    TEST_ASSERT_FALSE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("0123456", buff);
+
+    // Test numbers which fit exactly, and which are cut short.
+    sink_init(&sink, buff, sizeof(buff), NULL, NULL);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "12"));
+    TEST_ASSERT_TRUE(sink_write_uint(&sink, 4567, &g_grouped));
+    TEST_ASSERT_TRUE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("124,567", buff);
+    sink_init(&sink, buff, sizeof(buff), NULL, NULL);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "12"));
+    TEST_ASSERT_FALSE(sink_write_uint(&sink, 45678, &g_grouped));
+    TEST_ASSERT_FALSE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("1245,67", buff);
+
+    // Test a single byte buffer only ever holds the terminator.
+    sink_init(&sink, buff, 1, NULL, NULL);
+    TEST_ASSERT_TRUE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("", buff);
+    TEST_ASSERT_FALSE(sink_put(&sink, 'a'));
+    TEST_ASSERT_FALSE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("", buff);
+}
+
+void flush_callback() {
+    char buff[4];
+    Output out = {.accept = -1};
+    Sink sink;
+
+    // Test output leaves a full buffer at a time, and the rest on a flush.
+    sink_init(&sink, buff, sizeof(buff), output_write, &out);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "hello"));
+    TEST_ASSERT_TRUE(sink_put(&sink, ' '));
+    TEST_ASSERT_TRUE(sink_write_uint(&sink, 1234567, &g_grouped));
+    TEST_ASSERT_EQUAL_STRING("hello 1,234,", out.data);
+    TEST_ASSERT_EQUAL_INT(3, out.writes);
+    TEST_ASSERT_TRUE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("hello 1,234,567", out.data);
+    TEST_ASSERT_EQUAL_INT(4, out.writes);
+
+    // Test flushing an empty sink writes nothing, and the sink can go on.
+    TEST_ASSERT_TRUE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_INT(4, out.writes);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "!"));
+    TEST_ASSERT_TRUE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("hello 1,234,567!", out.data);
+
+    // Test a refused write fails the sink, and nothing reaches the callback
+    // after it.
+    out = (Output){.accept = 1};
+    sink_init(&sink, buff, sizeof(buff), output_write, &out);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "abcdefgh"));
+    TEST_ASSERT_FALSE(sink_write_str(&sink, "ijkl"));
+    TEST_ASSERT_FALSE(sink_put(&sink, 'm'));
+    TEST_ASSERT_FALSE(sink_flush(&sink));
+    TEST_ASSERT_EQUAL_STRING("abcd", out.data);
+    TEST_ASSERT_EQUAL_INT(1, out.writes);
+}
+
+void stream_callback() {
+    char buff[5], read[32];
+    Sink sink;
+    FILE *file = tmpfile();
+    TEST_ASSERT_NOT_NULL(file);
+
+    // Test output reaches a stdio stream whole.
+    sink_init(&sink, buff, sizeof(buff), sink_write_stream, file);
+    TEST_ASSERT_TRUE(sink_write_str(&sink, "0x"));
+    TEST_ASSERT_TRUE(sink_write_uint(&sink, 0xDEADBEEF, &(FormatSpec){FORMAT_BASE_HEX, 4, '_', false}));
+    TEST_ASSERT_TRUE(sink_flush(&sink));
+    rewind(file);
+    size_t len = fread(read, 1, sizeof(read) - 1, file);
+    read[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("0xDEAD_BEEF", read);
+    fclose(file);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(memory_truncation);
+    RUN_TEST(flush_callback);
+    RUN_TEST(stream_callback);
+
+    return UNITY_END();
+}
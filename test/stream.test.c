@@ -0,0 +1,129 @@
+// Streaming evaluator tests.
+
+#include <string.h>
+
+#include "unity.h"
+#include "expression.h"
+#include "stream.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint8_t g_arena[EXPR_ARENA_SIZE(MAX_TOKENS_PER_EXPR)];
+
+// Parses and evaluates the whole of str at once.
+static MathErr
+evaluate_whole(const char *str, uint64_t *result) {
+    Expression expr;
+    expression_init(&expr, g_arena, sizeof(g_arena));
+    MathErr err = expression_set_from_str(&expr, str);
+    if (err != MATH_ERR_OK) {
+        return err;
+    }
+    return expression_evaluate(&expr, result);
+}
+
+// Streams str in two chunks, split before the byte at split.
+static MathErr
+evaluate_split(const char *str, size_t split, uint64_t *result) {
+    ExprStream stream;
+    stream_init(&stream);
+    MathErr err = stream_feed(&stream, str, split);
+    if (err == MATH_ERR_OK) {
+        err = stream_feed(&stream, str + split, strlen(str) - split);
+    }
+    if (err == MATH_ERR_OK) {
+        err = stream_finish(&stream, result);
+    }
+    return err;
+}
+
+// Streams str a byte at a time.
+static MathErr
+evaluate_bytes(const char *str, uint64_t *result) {
+    ExprStream stream;
+    stream_init(&stream);
+    for (const char *c = str; *c != '\0'; c++) {
+        MathErr err = stream_feed_char(&stream, *c);
+        if (err != MATH_ERR_OK) {
+            return err;
+        }
+    }
+    return stream_finish(&stream, result);
+}
+
+// Checks streaming str split at every point, and a byte at a time, gives the
+// same result or error as parsing it whole.
+static void
+check_streams(const char *str) {
+    uint64_t expected = 0, result = 0;
+    MathErr expected_err = evaluate_whole(str, &expected);
+
+    for (size_t split = 0; split <= strlen(str); split++) {
+        TEST_ASSERT_EQUAL_MESSAGE(expected_err, evaluate_split(str, split, &result), str);
+        if (expected_err == MATH_ERR_OK) {
+            TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, result, str);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_MESSAGE(expected_err, evaluate_bytes(str, &result), str);
+    if (expected_err == MATH_ERR_OK) {
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, result, str);
+    }
+}
+
+void split_tokens() {
+    // Test literals and their prefixes split anywhere, IE 0|x1F.
+    check_streams("0x1F + 3");
+    check_streams("0b101 * 0B11");
+    check_streams("0777 - 017");
+    check_streams("18446744073709551615 + 12345678901234567");
+    check_streams("0x0123456789abcdef ^ 0");
+    check_streams("0");
+
+    // Test doubled operators split between their halves, IE <|<.
+    check_streams("1 << 2 >> 1");
+    check_streams("1<<3>>1");
+
+    // Test whitespace anywhere.
+    check_streams("  ( 1 +\t2 ) * 3  ");
+}
+
+void error_precedence() {
+    // Test lexing errors, some of which can only be known at the end.
+    check_streams("18446744073709551616");
+    check_streams("0x");
+    check_streams("1 + 0b");
+    check_streams("08 + 1");
+    check_streams("12ab");
+    check_streams("1 < 2");
+    check_streams("1 <");
+    check_streams("1 $ 2");
+
+    // Test a lexing error beats the errors of parsing or evaluating.
+    uint64_t result;
+    TEST_ASSERT_EQUAL(MATH_ERR_LITERAL_OVERFLOW, evaluate_whole("(1 + 99999999999999999999", &result));
+    check_streams("(1 + 99999999999999999999");
+    TEST_ASSERT_EQUAL(MATH_ERR_LITERAL_OVERFLOW, evaluate_whole("1 / 0 + 0x10000000000000000", &result));
+    check_streams("1 / 0 + 0x10000000000000000");
+    TEST_ASSERT_EQUAL(MATH_ERR_MALFORMED_EXPR, evaluate_whole(") 1 + 0x", &result));
+    check_streams(") 1 + 0x");
+    check_streams("(1 2 + 3g");
+    check_streams("1 / 0 + 0b102");
+
+    // Test errors of parsing and evaluating, in the order the tree gives them.
+    check_streams("(1 2");
+    check_streams("1 / 0 2");
+    check_streams("1 / 0 + (");
+    check_streams("1 % 0");
+    check_streams("");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(split_tokens);
+    RUN_TEST(error_precedence);
+
+    return UNITY_END();
+}
@@ -0,0 +1,162 @@
+// Tokenizer tests.
+
+#include <string.h>
+
+#include "unity.h"
+#include "token.h"
+#include "inttypes.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Checks str lexes as a single literal with value expected, which ends the
+// string.
+static void
+check_literal(const char *str, uint64_t expected) {
+    Token tok;
+    const char *end = NULL;
+    TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, token_set_from_str(&tok, str, &end), str);
+    TEST_ASSERT_EQUAL_MESSAGE(TOK_INTEGER, tok.type, str);
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected, tok.value, str);
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(str + strlen(str), end, str);
+}
+
+// Checks lexing str fails with expected.
+static void
+check_error(const char *str, MathErr expected) {
+    Token tok;
+    const char *end = NULL;
+    TEST_ASSERT_EQUAL_MESSAGE(expected, token_set_from_str(&tok, str, &end), str);
+}
+
+void overflow_edges() {
+    // Test the largest decimal literal, and one past it.
+    check_literal("18446744073709551615", UINT64_MAX);
+    check_error("18446744073709551616", MATH_ERR_LITERAL_OVERFLOW);
+    check_error("18446744073709551620", MATH_ERR_LITERAL_OVERFLOW);
+    check_error("99999999999999999999", MATH_ERR_LITERAL_OVERFLOW);
+    check_error("100000000000000000000", MATH_ERR_LITERAL_OVERFLOW);
+    check_literal("9999999999999999999", 9999999999999999999u);
+
+    // Test 16 hex digits fit, and a 17th significant one does not, however
+    // many leading zeros come before them.
+    check_literal("0xFFFFFFFFFFFFFFFF", UINT64_MAX);
+    check_error("0x1FFFFFFFFFFFFFFFF", MATH_ERR_LITERAL_OVERFLOW);
+    check_error("0x10000000000000000", MATH_ERR_LITERAL_OVERFLOW);
+    check_literal("0x0000000000000000FFFFFFFFFFFFFFFF", UINT64_MAX);
+
+    // Test 22 octal digits fit only while the first is 1.
+    check_literal("01777777777777777777777", UINT64_MAX);
+    check_error("02000000000000000000000", MATH_ERR_LITERAL_OVERFLOW);
+    check_error("010000000000000000000000", MATH_ERR_LITERAL_OVERFLOW);
+    check_literal("000001777777777777777777777", UINT64_MAX);
+
+    // Test 64 binary digits fit, and 65 do not unless the first is 0.
+    check_literal("0b1111111111111111111111111111111111111111111111111111111111111111", UINT64_MAX);
+    check_error("0b10000000000000000000000000000000000000000000000000000000000000000", MATH_ERR_LITERAL_OVERFLOW);
+    check_literal("0b01000000000000000000000000000000000000000000000000000000000000000", (uint64_t)1 << 63);
+}
+
+void chunk_boundaries() {
+    static const struct {
+        const char *prefix;
+        uint8_t base;
+        size_t max_len;
+    } bases[] = {
+        {"", 10, 19},
+        {"0x", 16, 16},
+        {"0", 8, 21},
+        {"0b", 2, 64},
+    };
+
+    // Test every length up to the largest which can not overflow, across the 8
+    // and 16 digit boundaries where whole chunks are converted at once.
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint8_t base = bases[i].base;
+        for (size_t len = 1; len <= bases[i].max_len; len++) {
+            char str[72];
+            size_t prefix_len = strlen(bases[i].prefix);
+            memcpy(str, bases[i].prefix, prefix_len);
+
+            uint64_t expected = 0;
+            for (size_t j = 0; j < len; j++) {
+                // Every digit of the base turns up, but never a leading 0,
+                // which would make a decimal literal octal.
+                uint8_t digit = (uint8_t)((j * 7 + 3) % base);
+                digit = j == 0 && digit == 0 ? 1 : digit;
+                str[prefix_len + j] = "0123456789ABCDEF"[digit];
+                expected = expected * base + digit;
+            }
+            str[prefix_len + len] = '\0';
+            check_literal(str, expected);
+        }
+    }
+
+    // Test no more than len bytes are read when the limit falls inside a chunk.
+    Token tok;
+    const char *end = NULL;
+    const char *str = "123456789";
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, token_set_from_buf(&tok, str, 8, &end));
+    TEST_ASSERT_EQUAL_UINT64(12345678, tok.value);
+    TEST_ASSERT_EQUAL_PTR(str + 8, end);
+
+    // Test both cases of hex letters inside a chunk.
+    check_literal("0xabcdefABCDEF1234", 0xABCDEFABCDEF1234);
+
+    // Test a literal ends at the first byte which is not a digit.
+    TEST_ASSERT_EQUAL(MATH_ERR_OK, token_set_from_str(&tok, "0x0123456789ABCDEF+1", &end));
+    TEST_ASSERT_EQUAL_UINT64(0x0123456789ABCDEF, tok.value);
+    TEST_ASSERT_EQUAL_CHAR('+', *end);
+}
+
+void malformed_literals() {
+    // Test a prefix needs digits after it.
+    check_error("0x", MATH_ERR_MALFORMED_EXPR);
+    check_error("0b", MATH_ERR_MALFORMED_EXPR);
+    check_error("0x+1", MATH_ERR_MALFORMED_EXPR);
+
+    // Test digits outside the base of the literal.
+    check_error("08", MATH_ERR_MALFORMED_EXPR);
+    check_error("0b102", MATH_ERR_MALFORMED_EXPR);
+    check_error("0779", MATH_ERR_MALFORMED_EXPR);
+
+    // Test a literal can not run straight into letters.
+    check_error("12ab", MATH_ERR_MALFORMED_EXPR);
+    check_error("0x1fx", MATH_ERR_MALFORMED_EXPR);
+
+    // Test a lone zero is still decimal.
+    check_literal("0", 0);
+}
+
+void printed_tokens() {
+    static const char *const strs[] = {
+        "(", ")", "~", "*", "/", "%", "+", "-", "<<", ">>", "&", "^", "|", "0", "18446744073709551615",
+    };
+    char buff[21];
+
+    // Test each token prints as the text it was lexed from.
+    for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+        Token tok;
+        const char *end;
+        TEST_ASSERT_EQUAL_MESSAGE(MATH_ERR_OK, token_set_from_str(&tok, strs[i], &end), strs[i]);
+        TEST_ASSERT_TRUE_MESSAGE(token_to_str(&tok, buff, sizeof(buff)), strs[i]);
+        TEST_ASSERT_EQUAL_STRING(strs[i], buff);
+    }
+
+    // Test a buffer with no room for the terminator is refused.
+    Token tok;
+    token_set_operator(&tok, TOK_BITWISE_LEFT_SHIFT);
+    TEST_ASSERT_FALSE(token_to_str(&tok, buff, 2));
+    TEST_ASSERT_TRUE(token_to_str(&tok, buff, 3));
+    TEST_ASSERT_EQUAL_STRING("<<", buff);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(overflow_edges);
+    RUN_TEST(chunk_boundaries);
+    RUN_TEST(malformed_literals);
+    RUN_TEST(printed_tokens);
+
+    return UNITY_END();
+}